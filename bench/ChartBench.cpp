@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cairo/cairo.h>
+#include "../include/StatsChart.hpp"
+#include "../include/ChartEncoder.hpp"
+#include "../include/Logger.hpp"
+
+Logger logger("../data/logs/bench", LogLevel::ERROR);
+
+static std::vector<std::pair<std::string, double>> randomStats(std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> value(0.0, 100.0);
+
+    return {
+        {"Strength", value(rng)},
+        {"Magic", value(rng)},
+        {"Vitality", value(rng)},
+        {"Agility", value(rng)},
+        {"Luck", value(rng)}
+    };
+}
+
+static double averageRenderMs(int iterations)
+{
+    std::mt19937 rng(42);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        drawStatsChart(randomStats(rng));
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+struct PngReader
+{
+    const std::string& data;
+    size_t offset;
+};
+
+static cairo_status_t readPngChunk(void* closure, unsigned char* data, unsigned int length)
+{
+    PngReader* reader = static_cast<PngReader*>(closure);
+    if (reader->offset + length > reader->data.size())
+    {
+        return CAIRO_STATUS_READ_ERROR;
+    }
+
+    std::copy_n(reader->data.data() + reader->offset, length, data);
+    reader->offset += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t* decodePng(const std::string& png)
+{
+    PngReader reader{png, 0};
+    return cairo_image_surface_create_from_png_stream(readPngChunk, &reader);
+}
+
+// Largest per-channel difference and the share of pixels differing by more than the tolerance
+static std::pair<int, double> pixelDiff(cairo_surface_t* a, cairo_surface_t* b, int tolerance)
+{
+    int width = cairo_image_surface_get_width(a);
+    int height = cairo_image_surface_get_height(a);
+    if (width != cairo_image_surface_get_width(b) || height != cairo_image_surface_get_height(b))
+    {
+        return {255, 1.0};
+    }
+
+    const unsigned char* dataA = cairo_image_surface_get_data(a);
+    const unsigned char* dataB = cairo_image_surface_get_data(b);
+    int strideA = cairo_image_surface_get_stride(a);
+    int strideB = cairo_image_surface_get_stride(b);
+
+    int maxDiff = 0;
+    size_t differing = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int pixelDiff = 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                pixelDiff = std::max(pixelDiff, std::abs(dataA[y * strideA + x * 4 + c] - dataB[y * strideB + x * 4 + c]));
+            }
+
+            maxDiff = std::max(maxDiff, pixelDiff);
+            if (pixelDiff > tolerance)
+            {
+                differing++;
+            }
+        }
+    }
+
+    return {maxDiff, static_cast<double>(differing) / (static_cast<double>(width) * height)};
+}
+
+static void benchmarkBackends(int iterations)
+{
+    setChartEncoderSettings(ChartEncoderSettings());
+
+    printf("\n%-10s %10s %16s\n", "backend", "ms/chart", "charts/s/core");
+    for (ChartBackend backend : {ChartBackend::CAIRO, ChartBackend::SOFTWARE})
+    {
+        setStatsChartBackend(backend);
+        double ms = averageRenderMs(iterations);
+        printf("%-10s %10.3f %16.1f\n", backend == ChartBackend::CAIRO ? "cairo" : "software", ms, 1000.0 / ms);
+    }
+
+    // Same stats through both backends
+    std::mt19937 rng(11);
+    int worstDiff = 0;
+    double worstShare = 0.0;
+
+    for (int i = 0; i < 20; ++i)
+    {
+        auto stats = randomStats(rng);
+
+        setStatsChartBackend(ChartBackend::CAIRO);
+        cairo_surface_t* reference = decodePng(drawStatsChart(stats));
+        setStatsChartBackend(ChartBackend::SOFTWARE);
+        cairo_surface_t* candidate = decodePng(drawStatsChart(stats));
+
+        auto diff = pixelDiff(reference, candidate, 32);
+        worstDiff = std::max(worstDiff, diff.first);
+        worstShare = std::max(worstShare, diff.second);
+
+        cairo_surface_destroy(reference);
+        cairo_surface_destroy(candidate);
+    }
+
+    setStatsChartBackend(ChartBackend::CAIRO);
+
+    printf("Software vs cairo: max channel diff %d, worst share of pixels off by >32: %.4f%%\n", worstDiff, worstShare * 100.0);
+}
+
+static double percentile(std::vector<double>& samples, double p)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * (samples.size() - 1) + 0.5));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+// Every thread renders its own randomized stat vectors at each size and records the
+// latency of every chart
+static void benchmarkLatency(int iterations, int threads)
+{
+    setChartEncoderSettings(ChartEncoderSettings());
+
+    printf("\n%-6s %8s %10s %10s %12s %16s\n", "size", "threads", "p50 ms", "p99 ms", "charts/s", "charts/s/thread");
+
+    for (int size : {250, 500, 1000})
+    {
+        std::vector<std::vector<double>> latencies(threads);
+        std::vector<std::thread> workers;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([t, size, iterations, &latencies]() {
+                std::mt19937 rng(1000 + t);
+                std::vector<double>& samples = latencies[t];
+                samples.reserve(iterations);
+
+                for (int i = 0; i < iterations; ++i)
+                {
+                    auto stats = randomStats(rng);
+                    auto chartStart = std::chrono::steady_clock::now();
+                    drawStatsChart(stats, size);
+                    samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - chartStart).count());
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> all;
+        for (const auto& samples : latencies)
+        {
+            all.insert(all.end(), samples.begin(), samples.end());
+        }
+
+        double total = static_cast<double>(all.size()) / seconds;
+        printf("%-6d %8d %10.3f %10.3f %12.1f %16.1f\n", size, threads, percentile(all, 0.50), percentile(all, 0.99), total, total / threads);
+    }
+}
+
+struct GoldenCase
+{
+    std::string name;
+    std::string png;
+};
+
+// Fixed stat vectors, including the edges of the value range, plus comparison charts
+static std::vector<GoldenCase> goldenCases()
+{
+    std::vector<GoldenCase> cases;
+    std::mt19937 rng(2024);
+
+    std::vector<std::vector<std::pair<std::string, double>>> vectors = {
+        {{"Strength", 0.0}, {"Magic", 0.0}, {"Vitality", 0.0}, {"Agility", 0.0}, {"Luck", 0.0}},
+        {{"Strength", 100.0}, {"Magic", 100.0}, {"Vitality", 100.0}, {"Agility", 100.0}, {"Luck", 100.0}},
+        {{"Strength", 25.0}, {"Magic", 25.0}, {"Vitality", 25.0}, {"Agility", 25.0}, {"Luck", 25.0}}
+    };
+    for (int i = 0; i < 3; ++i)
+    {
+        vectors.push_back(randomStats(rng));
+    }
+
+    for (int size : {250, 500, 1000})
+    {
+        for (size_t i = 0; i < vectors.size(); ++i)
+        {
+            cases.push_back({"stats_" + std::to_string(i) + "_" + std::to_string(size), drawStatsChart(vectors[i], size)});
+        }
+
+        cases.push_back({"compare_" + std::to_string(size), drawComparisonChart(vectors[2], vectors[3], size)});
+    }
+
+    return cases;
+}
+
+// Compares every golden case against DIR/<name>.png, or rewrites them when updating.
+// Returns the number of mismatching or missing cases, so a checkout without goldens
+// fails instead of passing without comparing anything.
+static int checkGoldenImages(const std::string& directory, bool update)
+{
+    const int tolerance = 8;
+    const double maxShare = 0.001;
+
+    setStatsChartBackend(ChartBackend::CAIRO);
+    setChartEncoderSettings(ChartEncoderSettings());
+
+    std::vector<GoldenCase> cases = goldenCases();
+
+    if (update)
+    {
+        std::filesystem::create_directories(directory);
+    }
+
+    printf("\nGolden images in %s\n", directory.c_str());
+
+    int failures = 0;
+    int missing = 0;
+
+    for (const auto& goldenCase : cases)
+    {
+        std::string path = directory + "/" + goldenCase.name + ".png";
+
+        if (update)
+        {
+            std::ofstream file(path, std::ios::binary);
+            file.write(goldenCase.png.data(), goldenCase.png.size());
+            continue;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            missing++;
+            continue;
+        }
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+
+        cairo_surface_t* golden = decodePng(buffer.str());
+        cairo_surface_t* rendered = decodePng(goldenCase.png);
+
+        auto diff = pixelDiff(golden, rendered, tolerance);
+        bool ok = diff.second <= maxShare;
+
+        if (!ok)
+        {
+            failures++;
+        }
+
+        printf("%-20s %s  max channel diff %3d, pixels off by >%d: %.4f%%\n", goldenCase.name.c_str(), ok ? "ok  " : "FAIL",
+               diff.first, tolerance, diff.second * 100.0);
+
+        cairo_surface_destroy(golden);
+        cairo_surface_destroy(rendered);
+    }
+
+    if (update)
+    {
+        printf("Wrote %zu golden images\n", cases.size());
+    }
+    else if (missing > 0)
+    {
+        printf("FAIL: %d golden images missing from %s, run with --update-golden to create them\n", missing, directory.c_str());
+    }
+
+    return failures + missing;
+}
+
+static void benchmarkEncoders(int iterations)
+{
+    std::mt19937 rng(7);
+    setChartEncoderSettings(ChartEncoderSettings());
+    std::string png = drawStatsChart(randomStats(rng));
+
+    cairo_surface_t* surface = decodePng(png);
+
+    std::vector<ChartEncoderSettings> variants;
+    variants.push_back({ChartFormat::PNG, 6, 85});
+    for (int level : {1, 6, 9})
+    {
+        variants.push_back({ChartFormat::PNG_RGB, level, 85});
+        variants.push_back({ChartFormat::PNG_PALETTE, level, 85});
+    }
+    for (int quality : {75, 90})
+    {
+        variants.push_back({ChartFormat::JPEG, 6, quality});
+        variants.push_back({ChartFormat::WEBP, 6, quality});
+    }
+
+    printf("\n%-12s %6s %8s %10s %12s\n", "format", "zlib", "quality", "bytes", "ms/encode");
+
+    std::string out;
+    for (const auto& settings : variants)
+    {
+        if (!chartFormatAvailable(settings.format))
+        {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            encodeChart(surface, settings, out);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        printf("%-12s %6d %8d %10zu %12.3f\n", chartFormatName(settings.format).c_str(), settings.zlibLevel, settings.quality,
+               out.size(), std::chrono::duration<double, std::milli>(end - start).count() / iterations);
+    }
+
+    cairo_surface_destroy(surface);
+}
+
+// Usage: ChartBench [iterations] [--threads N] [--golden DIR] [--update-golden]
+// The golden check only runs with --golden or --update-golden, since no golden images are
+// committed yet. With --golden, exits with 1 when a chart no longer matches its golden
+// image or a golden image is missing.
+int main(int argc, char* argv[])
+{
+    int iterations = 200;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string goldenDirectory = "../bench/golden";
+    bool checkGolden = false;
+    bool updateGolden = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+        {
+            goldenDirectory = argv[++i];
+            checkGolden = true;
+        }
+        else if (std::strcmp(argv[i], "--update-golden") == 0)
+        {
+            updateGolden = true;
+        }
+        else
+        {
+            iterations = std::max(1, std::atoi(argv[i]));
+        }
+    }
+
+    setStatsChartLayerCaching(false);
+    double uncached = averageRenderMs(iterations);
+
+    setStatsChartLayerCaching(true);
+    std::mt19937 rng(0);
+    warmStatsChartLayers(randomStats(rng));
+    double cached = averageRenderMs(iterations);
+
+    printf("Charts rendered per run: %d\n", iterations);
+    printf("Full render:          %.3f ms/chart\n", uncached);
+    printf("Cached static layers: %.3f ms/chart\n", cached);
+
+    benchmarkLatency(iterations, 1);
+    if (threads > 1)
+    {
+        benchmarkLatency(iterations, threads);
+    }
+
+    benchmarkBackends(iterations);
+    benchmarkEncoders(iterations);
+
+    if (!checkGolden && !updateGolden)
+    {
+        printf("\nGolden check skipped, pass --golden DIR to compare against golden images\n");
+        return 0;
+    }
+
+    return checkGoldenImages(goldenDirectory, updateGolden) > 0 ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#ifndef APIEXECUTOR_HPP
+#define APIEXECUTOR_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TokenBucket.hpp"
+
+// Interactive replies are sent before notifications to other users. Immediate calls
+// (answerCallbackQuery) don't count against the message limits and skip the pacing.
+enum class ApiPriority
+{
+    IMMEDIATE = 0,
+    INTERACTIVE = 1,
+    NOTIFICATION = 2
+};
+
+// Defaults follow Telegram's documented limits: about 30 messages per second overall
+// and one per second in a chat, with short bursts tolerated
+struct ApiRateLimits
+{
+    double globalPerSecond = 30.0;
+    double chatPerSecond = 1.0;
+    double chatBurst = 3.0;
+    // How many times a call answered with 429 is queued again
+    int maxRetries = 3;
+};
+
+struct ApiExecutorMetrics
+{
+    size_t queueDepth;
+    size_t interactiveDepth;
+    size_t notificationDepth;
+    size_t queueCapacity;
+    size_t calls;
+    size_t failed;
+    size_t rateLimited;
+    size_t throttledChats;
+    double avgCallMs;
+    double avgQueueWaitMs;
+};
+
+// Runs outbound Bot API calls off the handler threads. Calls are sharded by chat id
+// onto a fixed set of sender threads, so calls for one chat keep their order while
+// different chats are sent concurrently. Each sender thread reuses its own keep-alive
+// connection when the bot uses CurlHttpClient.
+//
+// Sending is paced by a global token bucket and one bucket per chat. A sender picks the
+// oldest call whose chat has a token, interactive calls first, so a throttled chat
+// doesn't hold up the others on its shard. Calls failing with 429 go back to the front
+// of their chat's queue and the chat is paused for the retry_after Telegram asked for.
+class ApiExecutor
+{
+public:
+    ApiExecutor(size_t workers, size_t queueCapacity, const ApiRateLimits& limits = ApiRateLimits());
+    ~ApiExecutor();
+
+    // Fire and forget; exceptions are logged. Waits for room when the chat's shard is
+    // full and returns false once the executor has been shut down. Called from a sender
+    // thread, the call is queued without waiting, even past capacity.
+    bool post(int64_t chatId, std::function<void()> call, ApiPriority priority = ApiPriority::INTERACTIVE);
+
+    // Called with the chat id of calls that failed with 403 (the user blocked the bot).
+    // Set it before posting anything.
+    void setForbiddenCallback(std::function<void(int64_t chatId)> callback);
+
+    // Stops accepting calls and sends everything already queued
+    void shutdown();
+
+    ApiExecutorMetrics getMetrics() const;
+
+private:
+    struct Call
+    {
+        int64_t chatId;
+        ApiPriority priority;
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point queuedAt;
+        int attempts;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable notFull;
+        std::array<std::deque<Call>, 3> queues;
+        std::unordered_map<int64_t, TokenBucket> chatBuckets;
+        size_t capacity = 0;
+        bool closed = false;
+        std::thread worker;
+
+        size_t size() const
+        {
+            return queues[0].size() + queues[1].size() + queues[2].size();
+        }
+    };
+
+    Shard& shardFor(int64_t chatId);
+    void workerLoop(Shard& shard);
+    bool takeNext(Shard& shard, std::unique_lock<std::mutex>& lock, Call& next);
+    TokenBucket& chatBucket(Shard& shard, int64_t chatId);
+    void waitForGlobalToken(ApiPriority priority);
+    void run(Shard& shard, Call call);
+
+    ApiRateLimits limits;
+    std::function<void(int64_t chatId)> onForbidden;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::mutex globalMutex;
+    TokenBucket globalBucket;
+
+    std::atomic<size_t> calls{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<size_t> rateLimited{0};
+    std::atomic<uint64_t> totalCallUs{0};
+    std::atomic<uint64_t> totalQueueWaitUs{0};
+};
+
+#endif
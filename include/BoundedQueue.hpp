@@ -0,0 +1,95 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Fixed-capacity multi-producer/multi-consumer queue. Producers choose between
+// failing fast (tryPush) and waiting for room (push); close() wakes everyone and
+// lets consumers drain what is left.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    bool tryPush(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (closed || items.size() >= capacity)
+            {
+                return false;
+            }
+            items.push_back(std::move(item));
+        }
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool push(T item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+            if (closed)
+            {
+                return false;
+            }
+            items.push_back(std::move(item));
+        }
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available. Returns nothing once the queue is closed and empty.
+    std::optional<T> pop()
+    {
+        std::optional<T> item;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+            if (items.empty())
+            {
+                return std::nullopt;
+            }
+            item.emplace(std::move(items.front()));
+            items.pop_front();
+        }
+        notFull.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return items.size();
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+private:
+    const size_t capacity;
+    mutable std::mutex queueMutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif
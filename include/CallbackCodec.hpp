@@ -0,0 +1,57 @@
+#ifndef CALLBACKCODEC_HPP
+#define CALLBACKCODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+// Append new actions at the end; the numeric values are part of buttons already sent
+enum class CallbackAction : uint8_t
+{
+    NONE = 0,
+    CHANGE_NAME = 1,
+    PROFILE = 2,
+    BACK_TO_MENU = 3,
+    SEND_FRIEND_REQUEST = 4,
+    VIEW_FRIEND_REQUESTS = 5,
+    FRIENDS_MENU = 6,
+    COMPARE = 7,
+    REMOVE_ALL_IN_REQUESTS = 8,
+    REMOVE_ALL_OUT_REQUESTS = 9
+};
+
+struct CallbackPayload
+{
+    static const size_t maxFields = 8;
+
+    uint8_t version = 0;
+    CallbackAction action = CallbackAction::NONE;
+    size_t fieldCount = 0;
+    int64_t fields[maxFields] = {};
+
+    int64_t field(size_t index) const
+    {
+        return index < fieldCount ? fields[index] : 0;
+    }
+};
+
+// Compact callback_data: a marker character, then base64url (no padding) of a schema
+// version byte, an action byte and up to maxFields zigzag varints. Two user ids take
+// 17 characters instead of the 29 of "compare_<id>_<id>", well inside Telegram's 64 bytes.
+class CallbackCodec
+{
+public:
+    static const uint8_t version = 1;
+    static const char marker = '~';
+    static const size_t maxLength = 64;
+
+    // Throws std::length_error when the result is longer than maxLength
+    static std::string encode(CallbackAction action, std::initializer_list<int64_t> fields = {});
+
+    // Fails on anything that isn't a well-formed payload of a known version
+    static bool decode(std::string_view data, CallbackPayload& payload);
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef CALLBACKDEDUPLICATOR_HPP
+#define CALLBACKDEDUPLICATOR_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Remembers which callbacks were handled recently, so a double tap on a button is only
+// handled once. Two callbacks are the same when the user and the callback data match.
+class CallbackDeduplicator
+{
+public:
+    explicit CallbackDeduplicator(std::chrono::milliseconds window);
+
+    // Records the callback and returns true when the same one was seen within the window
+    bool isDuplicate(int64_t userId, const std::string& data);
+
+    size_t getDuplicates() const;
+
+private:
+    void prune(std::chrono::steady_clock::time_point now);
+
+    std::chrono::milliseconds window;
+
+    mutable std::mutex seenMutex;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> seen;
+    size_t duplicates = 0;
+};
+
+#endif
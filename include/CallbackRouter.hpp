@@ -0,0 +1,52 @@
+#ifndef CALLBACKROUTER_HPP
+#define CALLBACKROUTER_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include <tgbot/tgbot.h>
+#include "CallbackCodec.hpp"
+
+// Maps callback_data prefixes to handlers. Prefixes are stored in a trie, so routing
+// walks the data once and costs the same however many buttons are registered. The
+// longest registered prefix wins and its handler gets the rest of the data as args.
+// CallbackCodec payloads skip the trie and are dispatched on their action byte.
+class CallbackRouter
+{
+public:
+    using Handler = std::function<void(const TgBot::CallbackQuery::Ptr& query, std::string_view args)>;
+    using ActionHandler = std::function<void(const TgBot::CallbackQuery::Ptr& query, const CallbackPayload& payload)>;
+
+    CallbackRouter();
+
+    void add(std::string_view prefix, Handler handler);
+    void addAction(CallbackAction action, ActionHandler handler);
+
+    // Text buttons of the form "<prefix><id>_<id>..." still on older messages are
+    // decoded into a payload with version 0 and passed to the action's handler
+    void addLegacyPrefix(std::string_view prefix, CallbackAction action);
+
+    // Returns false when no prefix matches
+    bool route(const TgBot::CallbackQuery::Ptr& query) const;
+
+    // Allocation-free argument parsing for handlers
+    static bool parseId(std::string_view text, int64_t& id);
+    static std::string_view nextArg(std::string_view& args, char separator = '_');
+
+private:
+    // Callback data is ASCII; any other byte ends the walk
+    struct Node
+    {
+        std::array<int32_t, 128> children;
+        int32_t handler = -1;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Handler> handlers;
+    std::array<ActionHandler, 256> actionHandlers;
+};
+
+#endif
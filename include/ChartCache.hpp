@@ -0,0 +1,56 @@
+#ifndef CHARTCACHE_HPP
+#define CHARTCACHE_HPP
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Rendered charts keyed by statsChartKey(), shared by every user with the same stats.
+// The memory tier is an LRU bounded in bytes. The optional disk tier survives restarts
+// and is an LRU bounded in bytes too: files are indexed at startup, oldest first, and
+// the least recently used ones are deleted once the tier goes over maxDiskBytes.
+class ChartCache {
+public:
+    static void configure(size_t maxBytes, bool diskTier, size_t maxDiskBytes = 256 * 1024 * 1024);
+    static std::shared_ptr<const std::string> get(const std::string& key);
+    static std::shared_ptr<const std::string> put(const std::string& key, std::string png);
+    static size_t getHits();
+    static size_t getMisses();
+private:
+    struct Entry
+    {
+        std::shared_ptr<const std::string> png;
+        std::list<std::string>::iterator lruIt;
+    };
+
+    struct DiskEntry
+    {
+        std::string path;
+        size_t bytes;
+        std::list<std::string>::iterator lruIt;
+    };
+
+    static std::shared_ptr<const std::string> insert(const std::string& key, std::shared_ptr<const std::string> png);
+    static void indexDisk();
+    // Returns the files to delete once the lock is released
+    static std::vector<std::string> insertDisk(const std::string& key, const std::string& path, size_t bytes);
+    static std::string diskPath(const std::string& key);
+
+    static std::mutex cacheMutex;
+    static std::unordered_map<std::string, Entry> entries;
+    static std::list<std::string> lru;
+    static size_t maxBytes;
+    static size_t currentBytes;
+    static bool diskTier;
+    static std::unordered_map<std::string, DiskEntry> diskEntries;
+    static std::list<std::string> diskLru;
+    static size_t maxDiskBytes;
+    static size_t currentDiskBytes;
+    static size_t hits;
+    static size_t misses;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CHARTENCODER_HPP
+#define CHARTENCODER_HPP
+
+#include <optional>
+#include <string>
+
+#include <cairo/cairo.h>
+
+enum class ChartFormat
+{
+    PNG,            // Cairo's own full-color PNG writer
+    PNG_RGB,        // Opaque RGB PNG with a chosen zlib level (needs libpng)
+    PNG_PALETTE,    // 8-bit palette-quantized PNG (needs libpng)
+    JPEG,           // Needs libjpeg
+    WEBP            // Needs libwebp
+};
+
+struct ChartEncoderSettings
+{
+    ChartFormat format = ChartFormat::PNG;
+    int zlibLevel = 6;      // 0-9, PNG_RGB and PNG_PALETTE
+    int quality = 85;       // 0-100, JPEG and WEBP
+};
+
+void setChartEncoderSettings(const ChartEncoderSettings& settings);
+ChartEncoderSettings getChartEncoderSettings();
+
+// Encodes an opaque ARGB32 surface. Returns false and leaves out empty on failure.
+bool encodeChart(cairo_surface_t* surface, const ChartEncoderSettings& settings, std::string& out);
+
+bool chartFormatAvailable(ChartFormat format);
+std::optional<ChartFormat> parseChartFormat(const std::string& name);
+std::string chartFormatName(ChartFormat format);
+std::string chartMimeType(ChartFormat format);
+std::string chartFileExtension(ChartFormat format);
+
+#endif
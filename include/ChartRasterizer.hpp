@@ -0,0 +1,77 @@
+#ifndef CHARTRASTERIZER_HPP
+#define CHARTRASTERIZER_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Premultiplied native-endian ARGB32 pixels, the same layout as a Cairo image surface.
+// The stride is in pixels.
+struct RasterTarget
+{
+    uint32_t* pixels;
+    int width;
+    int height;
+    int stride;
+};
+
+// Radial gradient centered on (cx, cy) with up to four color stops, padded past the last
+// stop like Cairo's default extend mode. A single stop is a solid color. The opacity
+// applies to the whole paint.
+struct RasterPaint
+{
+    struct Stop
+    {
+        float offset;
+        float r, g, b;
+    };
+
+    float cx = 0.0f;
+    float cy = 0.0f;
+    float radius = 1.0f;
+    Stop stops[4];
+    int numStops = 0;
+    float opacity = 1.0f;
+};
+
+// Coverage mask for one pre-rasterized glyph. The offsets place the mask relative to the
+// pen position on the baseline, in pixels; the advance is in the caller's layout units.
+struct RasterGlyph
+{
+    int width = 0;
+    int height = 0;
+    int offsetX = 0;
+    int offsetY = 0;
+    float advance = 0.0f;
+    std::vector<uint8_t> alpha;
+};
+
+// Purpose-built software renderer for the dynamic parts of the radar chart: antialiased
+// polygon fills with radial gradients, thick closed outlines, layer compositing and
+// glyph blits. Span shading and compositing use SSE2 when the target supports it.
+// Holds scratch buffers, so an instance must only be used by one thread at a time.
+class ChartRasterizer
+{
+public:
+    void fillPolygon(RasterTarget& target, const float* points, int count, const RasterPaint& paint);
+    void strokeClosedPolygon(RasterTarget& target, const float* points, int count, float width, const RasterPaint& paint);
+
+    static void copy(RasterTarget& target, const uint32_t* src, int srcStride);
+    static void compositeOver(RasterTarget& target, const uint32_t* src, int srcStride);
+    static void drawGlyph(RasterTarget& target, const RasterGlyph& glyph, int penX, int penY);
+
+private:
+    void prepare(const RasterTarget& target);
+    void accumulateLine(float x0, float y0, float x1, float y1);
+    void resolve(RasterTarget& target, const RasterPaint& paint);
+
+    std::vector<float> accumulation;
+    std::vector<float> coverage;
+    int width = 0;
+    int height = 0;
+    int minX = 0;
+    int maxX = 0;
+    int minY = 0;
+    int maxY = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CHARTRENDERPOOL_HPP
+#define CHARTRENDERPOOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+
+struct ChartRenderMetrics
+{
+    size_t queueDepth;
+    size_t queueCapacity;
+    size_t rendered;
+    size_t rejected;
+    double avgRenderMs;
+    double maxRenderMs;
+    double avgQueueWaitMs;
+};
+
+// Renders charts off the update thread. Each render takes a Cairo surface and context
+// from the chart canvas pool; finished charts go into ChartCache before the callback runs.
+// A render that throws is logged and its callback is skipped.
+class ChartRenderPool
+{
+public:
+    using Callback = std::function<void(std::shared_ptr<const std::string> png)>;
+    using Render = std::function<const std::string&()>;
+
+    ChartRenderPool(size_t workers, size_t queueCapacity);
+    ~ChartRenderPool();
+
+    // Any chart with a ChartCache key; the render runs on a worker only on a cache miss.
+    // Returns false without queueing anything when the queue is full.
+    bool submit(const std::string& chartKey, Render render, Callback onDone);
+
+    void shutdown();
+
+    ChartRenderMetrics getMetrics() const;
+
+private:
+    struct Job
+    {
+        std::string chartKey;
+        Render render;
+        Callback onDone;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    void workerLoop();
+
+    BoundedQueue<Job> jobs;
+    std::vector<std::thread> workers;
+
+    std::atomic<size_t> rendered{0};
+    std::atomic<size_t> renders{0};
+    std::atomic<size_t> rejected{0};
+    std::atomic<uint64_t> totalRenderUs{0};
+    std::atomic<uint64_t> maxRenderUs{0};
+    std::atomic<uint64_t> totalQueueWaitUs{0};
+};
+
+#endif
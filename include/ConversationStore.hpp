@@ -0,0 +1,92 @@
+#ifndef CONVERSATIONSTORE_HPP
+#define CONVERSATIONSTORE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// One type per step of a multi-step flow, holding what the next message needs
+struct AwaitingNewName
+{
+    std::string previousName;
+};
+
+struct AwaitingFriendId
+{
+};
+
+// std::monostate means the chat isn't in the middle of a flow
+using ConversationState = std::variant<std::monostate, AwaitingNewName, AwaitingFriendId>;
+
+struct ConversationMetrics
+{
+    size_t entries;
+    size_t expired;
+    size_t evicted;
+};
+
+// Per-chat conversation state shared by all update workers. Chats are spread over
+// independently locked shards. Every entry gets a deadline when it is set; each shard
+// keeps a timer wheel with one-second slots, advanced whenever the shard is touched
+// (and by expire()), so abandoned flows are dropped without scanning the whole map.
+// A shard never holds more than its share of maxEntries: the entry closest to its
+// deadline makes room for a new one.
+class ConversationStore
+{
+public:
+    ConversationStore(std::chrono::seconds ttl, size_t maxEntries, size_t shards = 16);
+
+    ConversationState get(int64_t chatId);
+    // Restarts the chat's deadline; std::monostate clears the chat
+    void set(int64_t chatId, ConversationState state);
+    void clear(int64_t chatId);
+
+    // Drops every entry past its deadline
+    void expire();
+
+    // Entries are stored with their wall-clock deadline, so flows still running when the
+    // bot stops can be picked up after a restart; expired ones are skipped on load.
+    // save() does nothing unless set() or clear() ran since the last successful save.
+    void save(const std::string& path);
+    void load(const std::string& path);
+
+    ConversationMetrics getMetrics() const;
+
+private:
+    struct Entry
+    {
+        ConversationState state;
+        int64_t deadline;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<int64_t, Entry> entries;
+        // Chat ids by deadline second modulo the wheel size; stale ids are skipped
+        std::vector<std::vector<int64_t>> wheel;
+        int64_t tick = 0;
+    };
+
+    static int64_t now();
+
+    Shard& shardFor(int64_t chatId);
+    void advance(Shard& shard, int64_t until);
+    void insert(Shard& shard, int64_t chatId, ConversationState state, int64_t deadline);
+
+    std::chrono::seconds ttl;
+    size_t maxEntriesPerShard;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::atomic<size_t> expired{0};
+    std::atomic<size_t> evicted{0};
+    std::atomic<bool> dirty{false};
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FILEIDCACHE_HPP
+#define FILEIDCACHE_HPP
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Telegram file_ids of charts that have already been uploaded, keyed by statsChartKey().
+// put() and remove() only mark the cache dirty; the periodic thread writes it out.
+class FileIdCache {
+public:
+    static void loadAll();
+    static void saveAll();
+    // Writes file_ids.json only if something changed since the last save; returns whether it did
+    static bool saveIfDirty();
+    static std::optional<std::string> get(const std::string& key);
+    static void put(const std::string& key, const std::string& fileId);
+    static void remove(const std::string& key);
+private:
+    static std::mutex cacheMutex;
+    // Serializes writers of file_ids.json; never held together with cacheMutex while writing
+    static std::mutex fileMutex;
+    static std::unordered_map<std::string, std::string> fileIds;
+    static bool dirty;
+};
+
+#endif
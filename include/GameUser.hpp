@@ -22,8 +22,19 @@ public:
     const std::vector<std::string> getIncomingFriendRequests() const;
     const std::vector<std::string> getOutcomingFriendRequests() const;
 
+    // Derived stats are recomputed whenever a raw stat changes, so reading them is just a
+    // lookup and a shared instance is never written to by a reader
+    const std::vector<std::pair<std::string, double>>& getDerivedStats() const;
+    double getDerivedStat(const std::string& name) const;
+    double getPowerScore() const;
+    int getLevel() const;
+    std::string getStatRank(const std::string& statName) const;
+    bool hasBlockedBot() const;
+
     void setGameName(const std::string& gameName);
     void setUsername(const std::string& username);
+    void setStat(const std::string& statName, double value);
+    void setBlockedBot(bool blocked);
 
     void addFriend(const std::string& friendId);
     void addIncomingFriendRequest(const std::string& friendId);
@@ -43,8 +54,16 @@ private:
 
     std::time_t registrationDate;
 
+    // Learned from 403 errors and my_chat_member updates, so notifications aren't sent blind
+    bool blockedBot = false;
+
     std::vector<std::pair<std::string, double>> stats;
 
+    std::vector<std::pair<std::string, double>> derivedStats;
+    std::vector<std::pair<std::string, std::string>> statRanks;
+
+    void computeDerivedStats();
+
     std::vector<std::string> friends;
     std::vector<std::string> incomingFriendRequests;
     std::vector<std::string> outcomingFriendRequests;
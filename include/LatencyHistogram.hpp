@@ -0,0 +1,89 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+struct LatencySummary
+{
+    std::string name;
+    uint64_t count;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+// HDR-style histogram of durations in microseconds: 16 linear sub-buckets per power of
+// two, so any recorded value is off by at most ~6%. Recording is a few relaxed atomic
+// adds on one of several shards picked per thread, so hot paths don't contend.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t micros);
+    LatencySummary summarize(const std::string& name) const;
+
+private:
+    static constexpr int subBucketBits = 4;
+    static constexpr int subBuckets = 1 << subBucketBits;
+    // Up to 2^40 us (about 12 days); longer values land in the last bucket
+    static constexpr int maxExponent = 40;
+    static constexpr size_t bucketCount = subBuckets + (maxExponent - subBucketBits) * subBuckets;
+    static constexpr size_t shardCount = 8;
+
+    static size_t bucketIndex(uint64_t micros);
+    static uint64_t bucketValue(size_t index);
+
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, bucketCount> counts{};
+        std::atomic<uint64_t> max{0};
+    };
+
+    std::unique_ptr<Shard[]> shards;
+};
+
+// Named histograms, created on first use and kept for the process lifetime so call
+// sites can hold on to the reference
+class LatencyRegistry
+{
+public:
+    static LatencyHistogram& get(const std::string& name);
+    // Sorted by name; histograms that never recorded anything are left out
+    static std::vector<LatencySummary> summarizeAll();
+
+private:
+    static std::shared_mutex registryMutex;
+    static std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+};
+
+// Records the time between construction and destruction
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyHistogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    explicit LatencyTimer(const std::string& name) : LatencyTimer(LatencyRegistry::get(name)) {}
+
+    ~LatencyTimer()
+    {
+        histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
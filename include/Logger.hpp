@@ -9,6 +9,8 @@
 #include <memory>
 #include <iomanip>
 #include <sstream>
+#include <filesystem>
+#include <mutex>
 
 enum class LogLevel
 {
@@ -19,7 +21,7 @@ enum class LogLevel
     BACKGROUND
 };
 
-std::string logLevelToString(LogLevel level)
+inline std::string logLevelToString(LogLevel level)
 {
     switch (level)
     {
@@ -32,7 +34,7 @@ std::string logLevelToString(LogLevel level)
     }
 }
 
-std::string getCurrentTimestamp()
+inline std::string getCurrentTimestamp()
 {
     auto now = std::chrono::system_clock::now();
     auto in_time_t = std::chrono::system_clock::to_time_t(now);
@@ -77,6 +79,8 @@ public:
     void log(LogLevel level, const std::string& message) {
         if (level >= logLevel) 
         {
+            std::lock_guard<std::mutex> lock(logMutex);
+
             if (outStream.is_open()) 
             {
                 auto now = std::chrono::system_clock::now();
@@ -95,7 +99,10 @@ private:
     std::string logFile;
     LogLevel logLevel;
     std::ofstream outStream;
+    std::mutex logMutex;
 
 };
 
+extern Logger logger;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef STATSCHART_HPP
+#define STATSCHART_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Bump whenever the chart layout changes so cached charts are not reused
+const int chartLayoutVersion = 3;
+
+const int chartDefaultSize = 500;
+
+enum class ChartBackend
+{
+    CAIRO,      // Cairo draws the stat polygon, outline and values
+    SOFTWARE    // ChartRasterizer draws them; only ChartBench selects it until it is measured against Cairo
+};
+
+double degreesToRadians(double degrees);
+
+void setStatsChartBackend(ChartBackend backend);
+ChartBackend getStatsChartBackend();
+
+// Renders the radar chart and returns it encoded with the current ChartEncoderSettings.
+// The buffer is owned by the calling thread and is overwritten by its next call.
+// Throws std::runtime_error if the chart can't be encoded.
+const std::string& drawStatsChart(const std::vector<std::pair<std::string, double>>& stats, int size = chartDefaultSize);
+
+// Same chart with the friend's stats drawn as a second, translucent polygon on the user's
+// axes. Shares the cached static layers and the thread-local buffer with drawStatsChart.
+// The background with the user's polygon is kept for a few recent users, so comparing
+// one user with several friends only draws the friend's polygon and the values.
+const std::string& drawComparisonChart(const std::vector<std::pair<std::string, double>>& stats,
+                                       const std::vector<std::pair<std::string, double>>& friendStats, int size = chartDefaultSize);
+
+// Pre-renders the static background layers for a stat schema (the stat names) and size
+void warmStatsChartLayers(const std::vector<std::pair<std::string, double>>& stats, int size = chartDefaultSize);
+
+// Turning caching off re-renders the static layers on every chart. Only meant for
+// benchmarking and must not be called while charts are being rendered.
+void setStatsChartLayerCaching(bool enabled);
+
+struct ChartPoolMetrics
+{
+    size_t acquired;
+    size_t reused;
+    size_t created;
+    size_t discarded;
+    size_t idle;
+    size_t limit;
+};
+
+// Rendering surfaces, contexts and patterns are pooled and reused across charts.
+// The limit is the number of idle canvases kept between renders.
+void setStatsChartPoolLimit(size_t maxIdleCanvases);
+ChartPoolMetrics getStatsChartPoolMetrics();
+
+std::string statsChartKey(const std::vector<std::pair<std::string, double>>& stats, int size = chartDefaultSize);
+std::string comparisonChartKey(const std::vector<std::pair<std::string, double>>& stats,
+                               const std::vector<std::pair<std::string, double>>& friendStats, int size = chartDefaultSize);
+
+#endif
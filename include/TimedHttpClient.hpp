@@ -0,0 +1,25 @@
+#ifndef TIMEDHTTPCLIENT_HPP
+#define TIMEDHTTPCLIENT_HPP
+
+#include <string>
+#include <vector>
+
+#include <tgbot/tgbot.h>
+
+// Wraps the bot's HttpClient and records every Bot API request in an "api <method>"
+// latency histogram. Reports no retries, so Api::sendRequest throws on the first failure
+// and ApiExecutor, which honours retry_after, is the only retry policy.
+class TimedHttpClient : public TgBot::HttpClient
+{
+public:
+    explicit TimedHttpClient(const TgBot::HttpClient& client);
+
+    std::string makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const override;
+    int getRequestMaxRetries() const override;
+    int getRequestBackoff() const override;
+
+private:
+    const TgBot::HttpClient& client;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef TOKENBUCKET_HPP
+#define TOKENBUCKET_HPP
+
+#include <algorithm>
+#include <chrono>
+
+// Classic token bucket: holds up to `burst` tokens and refills at `ratePerSecond`.
+// Not synchronized; callers guard it with their own lock.
+class TokenBucket
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double ratePerSecond, double burst)
+        : ratePerSecond(ratePerSecond), burst(burst), tokens(burst), updatedAt(Clock::now())
+    {
+    }
+
+    // Time until a token can be taken; zero when one is available now
+    Clock::duration waitTime(Clock::time_point now)
+    {
+        refill(now);
+
+        if (now < pausedUntil)
+        {
+            return pausedUntil - now;
+        }
+        if (tokens >= 1.0)
+        {
+            return Clock::duration::zero();
+        }
+
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - tokens) / ratePerSecond));
+    }
+
+    bool tryTake(Clock::time_point now)
+    {
+        if (waitTime(now) != Clock::duration::zero())
+        {
+            return false;
+        }
+
+        tokens -= 1.0;
+        return true;
+    }
+
+    // Takes a token even when none is left, borrowing from the future; returns how long
+    // the caller has to wait before using it
+    Clock::duration reserve(Clock::time_point now)
+    {
+        Clock::duration wait = waitTime(now);
+        tokens -= 1.0;
+        return wait;
+    }
+
+    // Used when the server asks to back off (retry_after)
+    void pause(Clock::time_point until)
+    {
+        pausedUntil = std::max(pausedUntil, until);
+        tokens = std::min(tokens, 0.0);
+    }
+
+    // A full, unpaused bucket carries no state and can be dropped
+    bool isIdle(Clock::time_point now)
+    {
+        refill(now);
+        return tokens >= burst && now >= pausedUntil;
+    }
+
+private:
+    void refill(Clock::time_point now)
+    {
+        if (now > updatedAt)
+        {
+            tokens = std::min(burst, tokens + std::chrono::duration<double>(now - updatedAt).count() * ratePerSecond);
+            updatedAt = now;
+        }
+    }
+
+    double ratePerSecond;
+    double burst;
+    double tokens;
+    Clock::time_point updatedAt;
+    Clock::time_point pausedUntil;
+};
+
+#endif
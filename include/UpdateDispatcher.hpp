@@ -0,0 +1,58 @@
+#ifndef UPDATEDISPATCHER_HPP
+#define UPDATEDISPATCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <tgbot/tgbot.h>
+#include "BoundedQueue.hpp"
+
+struct UpdateShardMetrics
+{
+    size_t queueDepth;
+    size_t maxQueueDepth;
+    size_t queueCapacity;
+    size_t handled;
+};
+
+// Hands updates to a fixed set of worker threads, one queue per worker. Updates are
+// sharded by chat id, so one chat's updates are handled in order on one thread while
+// different chats are handled in parallel.
+class UpdateDispatcher
+{
+public:
+    UpdateDispatcher(const TgBot::EventHandler& handler, size_t workers, size_t queueCapacity);
+    ~UpdateDispatcher();
+
+    // Waits for room when the chat's shard is full, which slows down polling.
+    // Returns false once the dispatcher has been shut down.
+    bool dispatch(const TgBot::Update::Ptr& update);
+
+    // Stops accepting updates, lets the workers drain their queues and joins them
+    void shutdown();
+
+    std::vector<UpdateShardMetrics> getMetrics() const;
+
+    static int64_t chatIdOf(const TgBot::Update::Ptr& update);
+
+private:
+    struct Shard
+    {
+        explicit Shard(size_t capacity) : updates(capacity) {}
+
+        BoundedQueue<TgBot::Update::Ptr> updates;
+        std::atomic<size_t> maxQueueDepth{0};
+        std::atomic<size_t> handled{0};
+        std::thread worker;
+    };
+
+    void workerLoop(Shard& shard);
+
+    const TgBot::EventHandler& handler;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+#endif
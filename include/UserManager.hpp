@@ -4,6 +4,8 @@
 #include <unordered_map>
 #include <chrono>
 #include <optional>
+#include <functional>
+#include <mutex>
 #include <filesystem>
 #include "GameUser.hpp"
 
@@ -12,11 +14,25 @@ public:
     static GameUser loadUser(const std::string& userId);
     static void loadAllUsers();
     static void saveUser(const GameUser& user);
+    // Applies change to the stored user while holding usersMutex, so concurrent
+    // read-modify-write cycles can't overwrite each other. Changes spanning two users
+    // nest a second updateUser inside change. Returns false if the user doesn't exist.
+    static bool updateUser(const std::string& userId, const std::function<void(GameUser&)>& change);
     static void saveAllUsers();
+    // Writes users.json only if something changed since the last save; returns whether it did
+    static bool saveIfDirty();
     static std::string getName(const std::string& userId);
     static std::optional<GameUser> loadFriend(const std::string& userId);
+    // Updated in place, so a stale copy passed to saveUser can't undo it
+    static bool hasBlockedBot(const std::string& userId);
+    static void setBlockedBot(const std::string& userId, bool blocked);
 private:
     static std::unordered_map<std::string, GameUser> usersCache;
+    // Recursive because loadUser saves every user when it creates a new one, and
+    // updateUser calls may nest
+    static std::recursive_mutex usersMutex;
+    // Set by every change to usersCache, cleared by saveAllUsers
+    static bool dirty;
 };
 
 #endif
\ No newline at end of file
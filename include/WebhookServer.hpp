@@ -0,0 +1,79 @@
+#ifndef WEBHOOKSERVER_HPP
+#define WEBHOOKSERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+struct WebhookConfig
+{
+    std::string address = "0.0.0.0";
+    unsigned short port = 8443;
+    std::string path = "/";
+    // Compared with the X-Telegram-Bot-Api-Secret-Token header; required
+    std::string secretToken;
+    // TLS is used when both files are set, plain HTTP behind a TLS proxy otherwise
+    std::string certificateFile;
+    std::string privateKeyFile;
+    size_t threads = 2;
+    // Request line and headers; also bounds what a client can make the server buffer
+    size_t maxHeaderBytes = 16 * 1024;
+    size_t maxBodyBytes = 1 << 20;
+    int idleTimeoutSeconds = 60;
+};
+
+struct WebhookMetrics
+{
+    size_t connections;
+    size_t openConnections;
+    size_t requests;
+    size_t rejected;
+};
+
+// Receives Telegram webhook updates over HTTP/1.1 with keep-alive. Connections are
+// served concurrently on a small io_context thread pool; each accepted request body is
+// passed to the callback, which must hand it off quickly (e.g. to UpdateDispatcher).
+class WebhookServer
+{
+public:
+    // Throwing from the callback answers the request with 400
+    using UpdateCallback = std::function<void(const std::string& body)>;
+
+    // Throws std::invalid_argument without a secret token
+    WebhookServer(const WebhookConfig& config, UpdateCallback onUpdate);
+    ~WebhookServer();
+
+    void start();
+    void stop();
+
+    WebhookMetrics getMetrics() const;
+
+    // Shared by the plain and TLS sessions
+    struct State
+    {
+        WebhookConfig config;
+        UpdateCallback onUpdate;
+        std::atomic<size_t> connections{0};
+        std::atomic<size_t> openConnections{0};
+        std::atomic<size_t> requests{0};
+        std::atomic<size_t> rejected{0};
+    };
+
+private:
+    void accept();
+
+    std::shared_ptr<State> state;
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::unique_ptr<boost::asio::ssl::context> tls;
+    std::vector<std::thread> threads;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include <tgbot/tgbot.h>
+
+#include "../include/ApiExecutor.hpp"
+#include "../include/Logger.hpp"
+
+// Telegram puts the delay in the error description: "Too Many Requests: retry after 5"
+static int retryAfterSeconds(const std::string& description)
+{
+    size_t at = description.find("retry after ");
+    int seconds = at == std::string::npos ? 0 : std::atoi(description.c_str() + at + 12);
+    return std::max(1, seconds);
+}
+
+// The shard whose worker is running on this thread, if any
+static thread_local const void* currentShard = nullptr;
+
+ApiExecutor::ApiExecutor(size_t workers, size_t queueCapacity, const ApiRateLimits& limits)
+    : limits(limits), globalBucket(limits.globalPerSecond, limits.globalPerSecond)
+{
+    for (size_t i = 0; i < std::max<size_t>(1, workers); ++i)
+    {
+        shards.push_back(std::make_unique<Shard>());
+        shards.back()->capacity = queueCapacity;
+    }
+
+    for (auto& shard : shards)
+    {
+        shard->worker = std::thread(&ApiExecutor::workerLoop, this, std::ref(*shard));
+    }
+}
+
+ApiExecutor::~ApiExecutor()
+{
+    shutdown();
+}
+
+ApiExecutor::Shard& ApiExecutor::shardFor(int64_t chatId)
+{
+    return *shards[static_cast<uint64_t>(chatId) % shards.size()];
+}
+
+bool ApiExecutor::post(int64_t chatId, std::function<void()> call, ApiPriority priority)
+{
+    Shard& shard = shardFor(chatId);
+    Call queued{chatId, priority, std::move(call), std::chrono::steady_clock::now(), 0};
+
+    // A call posted from any sender thread is queued even past capacity: waiting for room
+    // on its own shard could never finish, and two full shards posting into each other
+    // would wait on each other forever. It still goes through the chat's bucket and queue
+    // like any other. A nested call for the sender's own shard is accepted even after
+    // shutdown(), since that worker drains its queue before exiting.
+    bool fromSender = currentShard != nullptr;
+    bool nested = currentShard == &shard;
+
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        if (!fromSender)
+        {
+            shard.notFull.wait(lock, [&shard]() { return shard.closed || shard.size() < shard.capacity; });
+        }
+        if (shard.closed && !nested)
+        {
+            return false;
+        }
+        shard.queues[static_cast<size_t>(priority)].push_back(std::move(queued));
+    }
+    shard.ready.notify_one();
+    return true;
+}
+
+void ApiExecutor::setForbiddenCallback(std::function<void(int64_t chatId)> callback)
+{
+    onForbidden = std::move(callback);
+}
+
+void ApiExecutor::shutdown()
+{
+    for (auto& shard : shards)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->closed = true;
+        }
+        shard->ready.notify_all();
+        shard->notFull.notify_all();
+    }
+
+    for (auto& shard : shards)
+    {
+        if (shard->worker.joinable())
+        {
+            shard->worker.join();
+        }
+    }
+}
+
+ApiExecutorMetrics ApiExecutor::getMetrics() const
+{
+    ApiExecutorMetrics metrics = {};
+    auto now = std::chrono::steady_clock::now();
+
+    for (const auto& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        metrics.interactiveDepth += shard->queues[0].size() + shard->queues[1].size();
+        metrics.notificationDepth += shard->queues[2].size();
+        metrics.queueCapacity += shard->capacity;
+
+        for (auto& [chatId, bucket] : shard->chatBuckets)
+        {
+            if (bucket.waitTime(now) != TokenBucket::Clock::duration::zero())
+            {
+                metrics.throttledChats++;
+            }
+        }
+    }
+
+    size_t count = calls;
+    metrics.queueDepth = metrics.interactiveDepth + metrics.notificationDepth;
+    metrics.calls = count;
+    metrics.failed = failed;
+    metrics.rateLimited = rateLimited;
+    metrics.avgCallMs = count > 0 ? totalCallUs / 1000.0 / count : 0.0;
+    metrics.avgQueueWaitMs = count > 0 ? totalQueueWaitUs / 1000.0 / count : 0.0;
+
+    return metrics;
+}
+
+TokenBucket& ApiExecutor::chatBucket(Shard& shard, int64_t chatId)
+{
+    auto it = shard.chatBuckets.find(chatId);
+    if (it == shard.chatBuckets.end())
+    {
+        it = shard.chatBuckets.emplace(chatId, TokenBucket(limits.chatPerSecond, limits.chatBurst)).first;
+    }
+    return it->second;
+}
+
+void ApiExecutor::workerLoop(Shard& shard)
+{
+    currentShard = &shard;
+
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    Call next;
+
+    while (takeNext(shard, lock, next))
+    {
+        lock.unlock();
+        shard.notFull.notify_one();
+
+        waitForGlobalToken(next.priority);
+        run(shard, std::move(next));
+
+        lock.lock();
+    }
+}
+
+// Waits until some queued call may be sent and moves it into `next`; returns false once
+// the shard is closed and empty
+bool ApiExecutor::takeNext(Shard& shard, std::unique_lock<std::mutex>& lock, Call& next)
+{
+    while (true)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto wakeAt = TokenBucket::Clock::time_point::max();
+
+        if (!shard.queues[0].empty())
+        {
+            next = std::move(shard.queues[0].front());
+            shard.queues[0].pop_front();
+            return true;
+        }
+
+        for (size_t priority = 1; priority < shard.queues.size(); ++priority)
+        {
+            std::deque<Call>& queue = shard.queues[priority];
+
+            // Chats passed over in this queue, so a later call can't overtake an earlier one
+            std::vector<int64_t> waiting;
+
+            for (auto it = queue.begin(); it != queue.end(); ++it)
+            {
+                if (std::find(waiting.begin(), waiting.end(), it->chatId) != waiting.end())
+                {
+                    continue;
+                }
+
+                TokenBucket& bucket = chatBucket(shard, it->chatId);
+                if (bucket.tryTake(now))
+                {
+                    next = std::move(*it);
+                    queue.erase(it);
+                    return true;
+                }
+
+                waiting.push_back(it->chatId);
+                wakeAt = std::min(wakeAt, now + bucket.waitTime(now));
+            }
+        }
+
+        if (shard.closed && shard.size() == 0)
+        {
+            return false;
+        }
+
+        // Buckets of chats with nothing queued are forgotten once they have refilled
+        if (shard.chatBuckets.size() > shard.capacity)
+        {
+            for (auto it = shard.chatBuckets.begin(); it != shard.chatBuckets.end();)
+            {
+                it = it->second.isIdle(now) ? shard.chatBuckets.erase(it) : std::next(it);
+            }
+        }
+
+        if (wakeAt == TokenBucket::Clock::time_point::max())
+        {
+            shard.ready.wait(lock);
+        }
+        else
+        {
+            shard.ready.wait_until(lock, wakeAt);
+        }
+    }
+}
+
+void ApiExecutor::waitForGlobalToken(ApiPriority priority)
+{
+    if (priority == ApiPriority::IMMEDIATE)
+    {
+        return;
+    }
+
+    TokenBucket::Clock::duration wait;
+    {
+        std::lock_guard<std::mutex> lock(globalMutex);
+        wait = globalBucket.reserve(std::chrono::steady_clock::now());
+    }
+
+    if (wait > TokenBucket::Clock::duration::zero())
+    {
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+void ApiExecutor::run(Shard& shard, Call call)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    try
+    {
+        call.run();
+    }
+    catch (TgBot::TgException& e)
+    {
+        if (e.errorCode == TgBot::TgException::ErrorCode::TooManyRequests && call.attempts < limits.maxRetries)
+        {
+            rateLimited++;
+            int retryAfter = retryAfterSeconds(e.what());
+            logger.log(LogLevel::WARNING, "Bot API rate limit hit for chat " + std::to_string(call.chatId) + ", retrying in " + std::to_string(retryAfter) + "s.");
+
+            // Back at the front, so the chat's later calls still go out after this one
+            call.attempts++;
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                chatBucket(shard, call.chatId).pause(std::chrono::steady_clock::now() + std::chrono::seconds(retryAfter));
+                shard.queues[static_cast<size_t>(call.priority)].push_front(std::move(call));
+            }
+            shard.ready.notify_one();
+            return;
+        }
+
+        if (e.errorCode == TgBot::TgException::ErrorCode::Forbidden && onForbidden)
+        {
+            onForbidden(call.chatId);
+        }
+
+        failed++;
+        logger.log(LogLevel::ERROR, std::string("Bot API call failed: ") + e.what());
+    }
+    catch (std::exception& e)
+    {
+        failed++;
+        logger.log(LogLevel::ERROR, std::string("Bot API call failed: ") + e.what());
+    }
+
+    auto endTime = std::chrono::steady_clock::now();
+
+    calls++;
+    totalCallUs += std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+    totalQueueWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(startTime - call.queuedAt).count();
+}
@@ -0,0 +1,153 @@
+#include "../include/CallbackCodec.hpp"
+
+#include <stdexcept>
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Reverse lookup, -1 for bytes outside the alphabet
+struct Base64Table
+{
+    int8_t values[256];
+
+    Base64Table()
+    {
+        for (int8_t& value : values)
+        {
+            value = -1;
+        }
+        for (int i = 0; i < 64; ++i)
+        {
+            values[static_cast<unsigned char>(base64Alphabet[i])] = static_cast<int8_t>(i);
+        }
+    }
+};
+
+static const Base64Table base64Table;
+
+std::string CallbackCodec::encode(CallbackAction action, std::initializer_list<int64_t> fields)
+{
+    // Version, action and at most ten varint bytes per field
+    uint8_t bytes[2 + CallbackPayload::maxFields * 10];
+    size_t length = 0;
+
+    bytes[length++] = version;
+    bytes[length++] = static_cast<uint8_t>(action);
+
+    size_t count = 0;
+    for (int64_t field : fields)
+    {
+        if (count++ == CallbackPayload::maxFields)
+        {
+            break;
+        }
+
+        uint64_t value = (static_cast<uint64_t>(field) << 1) ^ static_cast<uint64_t>(field >> 63);
+        while (value >= 0x80)
+        {
+            bytes[length++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        bytes[length++] = static_cast<uint8_t>(value);
+    }
+
+    std::string data(1, marker);
+    data.reserve(1 + (length * 4 + 2) / 3);
+
+    for (size_t i = 0; i < length; i += 3)
+    {
+        uint32_t chunk = static_cast<uint32_t>(bytes[i]) << 16;
+        if (i + 1 < length)
+        {
+            chunk |= static_cast<uint32_t>(bytes[i + 1]) << 8;
+        }
+        if (i + 2 < length)
+        {
+            chunk |= bytes[i + 2];
+        }
+
+        data += base64Alphabet[(chunk >> 18) & 0x3f];
+        data += base64Alphabet[(chunk >> 12) & 0x3f];
+        if (i + 1 < length)
+        {
+            data += base64Alphabet[(chunk >> 6) & 0x3f];
+        }
+        if (i + 2 < length)
+        {
+            data += base64Alphabet[chunk & 0x3f];
+        }
+    }
+
+    if (data.size() > maxLength)
+    {
+        throw std::length_error("Callback data is " + std::to_string(data.size()) + " bytes, over Telegram's " + std::to_string(maxLength));
+    }
+
+    return data;
+}
+
+bool CallbackCodec::decode(std::string_view data, CallbackPayload& payload)
+{
+    if (data.empty() || data[0] != marker || data.size() > maxLength)
+    {
+        return false;
+    }
+
+    // 63 base64 characters decode to at most 47 bytes
+    uint8_t bytes[48];
+    size_t length = 0;
+    uint32_t bits = 0;
+    int bitCount = 0;
+
+    for (size_t i = 1; i < data.size(); ++i)
+    {
+        int8_t value = base64Table.values[static_cast<unsigned char>(data[i])];
+        if (value < 0)
+        {
+            return false;
+        }
+
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bitCount += 6;
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            bytes[length++] = static_cast<uint8_t>(bits >> bitCount);
+        }
+    }
+
+    if (length < 2 || bytes[0] != version)
+    {
+        return false;
+    }
+
+    payload.version = bytes[0];
+    payload.action = static_cast<CallbackAction>(bytes[1]);
+    payload.fieldCount = 0;
+
+    size_t offset = 2;
+    while (offset < length)
+    {
+        if (payload.fieldCount == CallbackPayload::maxFields)
+        {
+            return false;
+        }
+
+        uint64_t value = 0;
+        int shift = 0;
+        uint8_t byte;
+        do
+        {
+            if (offset == length || shift > 63)
+            {
+                return false;
+            }
+            byte = bytes[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        payload.fields[payload.fieldCount++] = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    return true;
+}
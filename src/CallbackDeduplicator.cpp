@@ -0,0 +1,45 @@
+#include "../include/CallbackDeduplicator.hpp"
+
+// Expired entries are only swept once the map has grown this much
+static const size_t pruneThreshold = 1024;
+
+CallbackDeduplicator::CallbackDeduplicator(std::chrono::milliseconds window) : window(window)
+{
+}
+
+bool CallbackDeduplicator::isDuplicate(int64_t userId, const std::string& data)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::string key = std::to_string(userId) + ":" + data;
+
+    std::lock_guard<std::mutex> lock(seenMutex);
+
+    auto it = seen.find(key);
+    if (it != seen.end() && now - it->second < window)
+    {
+        duplicates++;
+        return true;
+    }
+
+    if (seen.size() >= pruneThreshold)
+    {
+        prune(now);
+    }
+
+    seen[key] = now;
+    return false;
+}
+
+size_t CallbackDeduplicator::getDuplicates() const
+{
+    std::lock_guard<std::mutex> lock(seenMutex);
+    return duplicates;
+}
+
+void CallbackDeduplicator::prune(std::chrono::steady_clock::time_point now)
+{
+    for (auto it = seen.begin(); it != seen.end();)
+    {
+        it = now - it->second >= window ? seen.erase(it) : std::next(it);
+    }
+}
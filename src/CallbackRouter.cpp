@@ -0,0 +1,124 @@
+#include <charconv>
+
+#include "../include/CallbackRouter.hpp"
+
+CallbackRouter::CallbackRouter()
+{
+    nodes.emplace_back();
+    nodes.back().children.fill(-1);
+}
+
+void CallbackRouter::add(std::string_view prefix, Handler handler)
+{
+    int32_t node = 0;
+
+    for (char c : prefix)
+    {
+        unsigned char index = static_cast<unsigned char>(c) & 0x7f;
+
+        if (nodes[node].children[index] < 0)
+        {
+            nodes[node].children[index] = static_cast<int32_t>(nodes.size());
+            nodes.emplace_back();
+            nodes.back().children.fill(-1);
+        }
+
+        node = nodes[node].children[index];
+    }
+
+    nodes[node].handler = static_cast<int32_t>(handlers.size());
+    handlers.push_back(std::move(handler));
+}
+
+void CallbackRouter::addAction(CallbackAction action, ActionHandler handler)
+{
+    actionHandlers[static_cast<uint8_t>(action)] = std::move(handler);
+}
+
+void CallbackRouter::addLegacyPrefix(std::string_view prefix, CallbackAction action)
+{
+    add(prefix, [this, action](const TgBot::CallbackQuery::Ptr& query, std::string_view args) {
+        const ActionHandler& handler = actionHandlers[static_cast<uint8_t>(action)];
+
+        CallbackPayload payload;
+        payload.action = action;
+
+        while (!args.empty())
+        {
+            if (payload.fieldCount == CallbackPayload::maxFields || !parseId(nextArg(args), payload.fields[payload.fieldCount]))
+            {
+                return;
+            }
+            payload.fieldCount++;
+        }
+
+        if (handler)
+        {
+            handler(query, payload);
+        }
+    });
+}
+
+bool CallbackRouter::route(const TgBot::CallbackQuery::Ptr& query) const
+{
+    std::string_view data = query->data;
+
+    if (!data.empty() && data[0] == CallbackCodec::marker)
+    {
+        CallbackPayload payload;
+        if (!CallbackCodec::decode(data, payload))
+        {
+            return false;
+        }
+
+        const ActionHandler& handler = actionHandlers[static_cast<uint8_t>(payload.action)];
+        if (!handler)
+        {
+            return false;
+        }
+
+        handler(query, payload);
+        return true;
+    }
+
+    int32_t node = 0;
+    int32_t matched = nodes[0].handler;
+    size_t matchedLength = 0;
+
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c >= 128 || (node = nodes[node].children[c]) < 0)
+        {
+            break;
+        }
+
+        if (nodes[node].handler >= 0)
+        {
+            matched = nodes[node].handler;
+            matchedLength = i + 1;
+        }
+    }
+
+    if (matched < 0)
+    {
+        return false;
+    }
+
+    handlers[matched](query, data.substr(matchedLength));
+    return true;
+}
+
+bool CallbackRouter::parseId(std::string_view text, int64_t& id)
+{
+    auto result = std::from_chars(text.data(), text.data() + text.size(), id);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+std::string_view CallbackRouter::nextArg(std::string_view& args, char separator)
+{
+    size_t end = args.find(separator);
+    std::string_view arg = args.substr(0, end);
+    args = end == std::string_view::npos ? std::string_view() : args.substr(end + 1);
+    return arg;
+}
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+#include <iterator>
+
+#include "../include/ChartCache.hpp"
+#include "../include/ChartEncoder.hpp"
+#include "../include/Logger.hpp"
+
+static const std::string diskDirectory = "../data/img/cache";
+
+// Render workers don't coalesce identical keys, so two put() calls can write the same
+// chart at once; each write gets its own temporary name
+static std::atomic<uint64_t> tmpCounter{0};
+
+std::mutex ChartCache::cacheMutex;
+std::unordered_map<std::string, ChartCache::Entry> ChartCache::entries;
+std::list<std::string> ChartCache::lru;
+size_t ChartCache::maxBytes = 64 * 1024 * 1024;
+size_t ChartCache::currentBytes = 0;
+bool ChartCache::diskTier = false;
+std::unordered_map<std::string, ChartCache::DiskEntry> ChartCache::diskEntries;
+std::list<std::string> ChartCache::diskLru;
+size_t ChartCache::maxDiskBytes = 256 * 1024 * 1024;
+size_t ChartCache::currentDiskBytes = 0;
+size_t ChartCache::hits = 0;
+size_t ChartCache::misses = 0;
+
+void ChartCache::configure(size_t maxBytes, bool diskTier, size_t maxDiskBytes)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    ChartCache::maxBytes = maxBytes;
+    ChartCache::diskTier = diskTier;
+    ChartCache::maxDiskBytes = maxDiskBytes;
+
+    if (diskTier)
+    {
+        std::filesystem::create_directories(diskDirectory);
+        indexDisk();
+    }
+}
+
+// Called with cacheMutex held, once at startup
+void ChartCache::indexDisk()
+{
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::directory_entry>> files;
+    std::error_code ec;
+
+    for (const auto& file : std::filesystem::directory_iterator(diskDirectory, ec))
+    {
+        if (!file.is_regular_file(ec))
+        {
+            continue;
+        }
+
+        // Left behind by a write that never finished
+        if (file.path().extension() == ".tmp")
+        {
+            std::filesystem::remove(file.path(), ec);
+            continue;
+        }
+
+        files.emplace_back(file.last_write_time(ec), file);
+    }
+
+    // Oldest first, so the most recently written files end up at the front of the LRU
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<std::string> evicted;
+    for (const auto& [time, file] : files)
+    {
+        std::vector<std::string> victims = insertDisk(file.path().stem().string(), file.path().string(), file.file_size(ec));
+        evicted.insert(evicted.end(), victims.begin(), victims.end());
+    }
+
+    for (const auto& path : evicted)
+    {
+        std::filesystem::remove(path, ec);
+    }
+
+    logger.log(LogLevel::INFO, "Chart disk cache: " + std::to_string(diskEntries.size()) + " files, " + std::to_string(currentDiskBytes / 1024) +
+                               " KB, " + std::to_string(evicted.size()) + " evicted");
+}
+
+std::shared_ptr<const std::string> ChartCache::get(const std::string& key)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            lru.splice(lru.begin(), lru, it->second.lruIt);
+            hits++;
+            return it->second.png;
+        }
+
+        auto diskIt = diskTier ? diskEntries.find(key) : diskEntries.end();
+        if (diskIt == diskEntries.end())
+        {
+            misses++;
+            return nullptr;
+        }
+
+        diskLru.splice(diskLru.begin(), diskLru, diskIt->second.lruIt);
+        path = diskIt->second.path;
+    }
+
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile)
+    {
+        // Deleted behind our back
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto diskIt = diskEntries.find(key);
+        if (diskIt != diskEntries.end())
+        {
+            currentDiskBytes -= diskIt->second.bytes;
+            diskLru.erase(diskIt->second.lruIt);
+            diskEntries.erase(diskIt);
+        }
+        misses++;
+        return nullptr;
+    }
+
+    auto png = std::make_shared<const std::string>(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    hits++;
+    return insert(key, png);
+}
+
+std::shared_ptr<const std::string> ChartCache::put(const std::string& key, std::string png)
+{
+    auto shared = std::make_shared<const std::string>(std::move(png));
+
+    bool writeToDisk;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        shared = insert(key, shared);
+        writeToDisk = diskTier && diskEntries.find(key) == diskEntries.end();
+    }
+
+    if (writeToDisk)
+    {
+        // Write to a temporary name first so a concurrent reader never sees a partial file
+        std::string path = diskPath(key);
+        std::string tmpPath = path + "." + std::to_string(tmpCounter++) + ".tmp";
+        bool written;
+        {
+            std::ofstream outFile(tmpPath, std::ios::binary);
+            outFile.write(shared->data(), shared->size());
+            written = static_cast<bool>(outFile);
+        }
+
+        std::error_code ec;
+        if (written)
+        {
+            std::filesystem::rename(tmpPath, path, ec);
+        }
+        if (!written || ec)
+        {
+            std::filesystem::remove(tmpPath, ec);
+            return shared;
+        }
+
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            evicted = insertDisk(key, path, shared->size());
+        }
+
+        for (const auto& victim : evicted)
+        {
+            std::filesystem::remove(victim, ec);
+        }
+    }
+
+    return shared;
+}
+
+size_t ChartCache::getHits()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return hits;
+}
+
+size_t ChartCache::getMisses()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return misses;
+}
+
+std::shared_ptr<const std::string> ChartCache::insert(const std::string& key, std::shared_ptr<const std::string> png)
+{
+    auto it = entries.find(key);
+    if (it != entries.end())
+    {
+        lru.splice(lru.begin(), lru, it->second.lruIt);
+        return it->second.png;
+    }
+
+    // A chart bigger than the whole budget is returned but never kept
+    if (png->size() > maxBytes)
+    {
+        return png;
+    }
+
+    while (currentBytes + png->size() > maxBytes && !lru.empty())
+    {
+        auto victim = entries.find(lru.back());
+        currentBytes -= victim->second.png->size();
+        entries.erase(victim);
+        lru.pop_back();
+    }
+
+    lru.push_front(key);
+    entries[key] = Entry{png, lru.begin()};
+    currentBytes += png->size();
+
+    return png;
+}
+
+// Called with cacheMutex held
+std::vector<std::string> ChartCache::insertDisk(const std::string& key, const std::string& path, size_t bytes)
+{
+    std::vector<std::string> evicted;
+
+    auto it = diskEntries.find(key);
+    if (it != diskEntries.end())
+    {
+        currentDiskBytes -= it->second.bytes;
+        diskLru.erase(it->second.lruIt);
+        if (it->second.path != path)
+        {
+            evicted.push_back(it->second.path);
+        }
+        diskEntries.erase(it);
+    }
+
+    diskLru.push_front(key);
+    diskEntries[key] = DiskEntry{path, bytes, diskLru.begin()};
+    currentDiskBytes += bytes;
+
+    while (currentDiskBytes > maxDiskBytes && !diskLru.empty())
+    {
+        auto victim = diskEntries.find(diskLru.back());
+        currentDiskBytes -= victim->second.bytes;
+        evicted.push_back(victim->second.path);
+        diskEntries.erase(victim);
+        diskLru.pop_back();
+    }
+
+    return evicted;
+}
+
+// Keys already encode the chart format, so the extension only has to match it for anyone
+// looking at the files
+std::string ChartCache::diskPath(const std::string& key)
+{
+    return diskDirectory + "/" + key + "." + chartFileExtension(getChartEncoderSettings().format);
+}
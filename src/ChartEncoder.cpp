@@ -0,0 +1,369 @@
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#ifdef HAVE_PNG
+#include <png.h>
+#endif
+#ifdef HAVE_JPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+#ifdef HAVE_WEBP
+#include <webp/encode.h>
+#endif
+
+#include "../include/ChartEncoder.hpp"
+
+static std::mutex settingsMutex;
+static ChartEncoderSettings currentSettings;
+
+void setChartEncoderSettings(const ChartEncoderSettings& settings)
+{
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    currentSettings = settings;
+}
+
+ChartEncoderSettings getChartEncoderSettings()
+{
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    return currentSettings;
+}
+
+static cairo_status_t appendChunk(void* closure, const unsigned char* data, unsigned int length)
+{
+    static_cast<std::string*>(closure)->append(reinterpret_cast<const char*>(data), length);
+    return CAIRO_STATUS_SUCCESS;
+}
+
+// Unpacks the native-endian ARGB32 pixels into tightly packed RGB rows. The chart is
+// opaque, so premultiplication doesn't change the color channels.
+static void surfaceToRgb(cairo_surface_t* surface, std::vector<unsigned char>& rgb)
+{
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    const unsigned char* data = cairo_image_surface_get_data(surface);
+
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    unsigned char* dst = rgb.data();
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(data + static_cast<size_t>(y) * stride);
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t pixel = row[x];
+            *dst++ = (pixel >> 16) & 0xff;
+            *dst++ = (pixel >> 8) & 0xff;
+            *dst++ = pixel & 0xff;
+        }
+    }
+}
+
+#ifdef HAVE_PNG
+static void pngWrite(png_structp png, png_bytep data, png_size_t length)
+{
+    static_cast<std::string*>(png_get_io_ptr(png))->append(reinterpret_cast<const char*>(data), length);
+}
+
+static void pngFlush(png_structp)
+{
+}
+
+// Fixed 6x7x6 color cube: 252 entries, so mapping a pixel is three multiplies, no search
+static const int paletteLevelsR = 6;
+static const int paletteLevelsG = 7;
+static const int paletteLevelsB = 6;
+
+// 8x8 Bayer matrix for ordered dithering. Unlike error diffusion it needs no state
+// between pixels, and its regular pattern compresses well.
+static const unsigned char bayer8[8][8] =
+{
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+// floor(value * (levels - 1) / 255 + (threshold + 0.5) / 64) in integers; never above levels - 1
+static int ditherLevel(int value, int levels, int threshold)
+{
+    return (value * (levels - 1) * 128 + (2 * threshold + 1) * 255) / (255 * 128);
+}
+
+static bool encodePng(cairo_surface_t* surface, bool palette, int zlibLevel, std::string& out)
+{
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+
+    thread_local std::vector<unsigned char> rgb;
+    thread_local std::vector<unsigned char> indexed;
+    surfaceToRgb(surface, rgb);
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (png == nullptr)
+    {
+        return false;
+    }
+
+    png_infop info = png_create_info_struct(png);
+    if (info == nullptr || setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_write_struct(&png, &info);
+        out.clear();
+        return false;
+    }
+
+    png_set_write_fn(png, &out, pngWrite, pngFlush);
+    png_set_compression_level(png, zlibLevel);
+
+    size_t rowBytes;
+    const unsigned char* pixels;
+
+    if (palette)
+    {
+        png_color colors[paletteLevelsR * paletteLevelsG * paletteLevelsB];
+        int entry = 0;
+
+        for (int r = 0; r < paletteLevelsR; ++r)
+        {
+            for (int g = 0; g < paletteLevelsG; ++g)
+            {
+                for (int b = 0; b < paletteLevelsB; ++b)
+                {
+                    colors[entry].red = r * 255 / (paletteLevelsR - 1);
+                    colors[entry].green = g * 255 / (paletteLevelsG - 1);
+                    colors[entry].blue = b * 255 / (paletteLevelsB - 1);
+                    entry++;
+                }
+            }
+        }
+
+        // Dithered, so the background gradient doesn't turn into bands of cube colors
+        indexed.resize(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                size_t i = static_cast<size_t>(y) * width + x;
+                int threshold = bayer8[y & 7][x & 7];
+                int r = ditherLevel(rgb[i * 3], paletteLevelsR, threshold);
+                int g = ditherLevel(rgb[i * 3 + 1], paletteLevelsG, threshold);
+                int b = ditherLevel(rgb[i * 3 + 2], paletteLevelsB, threshold);
+                indexed[i] = static_cast<unsigned char>((r * paletteLevelsG + g) * paletteLevelsB + b);
+            }
+        }
+
+        png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        png_set_PLTE(png, info, colors, entry);
+        // Filtering rarely helps indexed images and costs encode time
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+
+        rowBytes = width;
+        pixels = indexed.data();
+    }
+    else
+    {
+        png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+        rowBytes = static_cast<size_t>(width) * 3;
+        pixels = rgb.data();
+    }
+
+    png_write_info(png, info);
+    for (int y = 0; y < height; ++y)
+    {
+        png_write_row(png, const_cast<png_bytep>(pixels + y * rowBytes));
+    }
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+
+    return true;
+}
+#endif
+
+#ifdef HAVE_JPEG
+// libjpeg's default error_exit calls exit(); jump back into encodeJpeg instead.
+struct JpegErrorManager
+{
+    jpeg_error_mgr base;
+    jmp_buf jump;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+}
+
+static bool encodeJpeg(cairo_surface_t* surface, int quality, std::string& out)
+{
+    thread_local std::vector<unsigned char> rgb;
+    surfaceToRgb(surface, rgb);
+
+    jpeg_compress_struct cinfo = {};
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.base);
+    jerr.base.error_exit = jpegErrorExit;
+
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    if (setjmp(jerr.jump))
+    {
+        jpeg_destroy_compress(&cinfo);
+        free(buffer);
+        out.clear();
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+
+    cinfo.image_width = cairo_image_surface_get_width(surface);
+    cinfo.image_height = cairo_image_surface_get_height(surface);
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        JSAMPROW row = rgb.data() + static_cast<size_t>(cinfo.next_scanline) * cinfo.image_width * 3;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    out.assign(reinterpret_cast<const char*>(buffer), size);
+    free(buffer);
+
+    return true;
+}
+#endif
+
+#ifdef HAVE_WEBP
+static bool encodeWebp(cairo_surface_t* surface, int quality, std::string& out)
+{
+    thread_local std::vector<unsigned char> rgb;
+    surfaceToRgb(surface, rgb);
+
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+
+    uint8_t* encoded = nullptr;
+    size_t size = WebPEncodeRGB(rgb.data(), width, height, width * 3, quality, &encoded);
+    if (size == 0)
+    {
+        return false;
+    }
+
+    out.assign(reinterpret_cast<const char*>(encoded), size);
+    WebPFree(encoded);
+
+    return true;
+}
+#endif
+
+bool encodeChart(cairo_surface_t* surface, const ChartEncoderSettings& settings, std::string& out)
+{
+    out.clear();
+    cairo_surface_flush(surface);
+
+    switch (settings.format)
+    {
+    case ChartFormat::PNG:
+        if (cairo_surface_write_to_png_stream(surface, appendChunk, &out) != CAIRO_STATUS_SUCCESS)
+        {
+            out.clear();
+            return false;
+        }
+        return true;
+#ifdef HAVE_PNG
+    case ChartFormat::PNG_RGB:
+        return encodePng(surface, false, settings.zlibLevel, out);
+    case ChartFormat::PNG_PALETTE:
+        return encodePng(surface, true, settings.zlibLevel, out);
+#endif
+#ifdef HAVE_JPEG
+    case ChartFormat::JPEG:
+        return encodeJpeg(surface, settings.quality, out);
+#endif
+#ifdef HAVE_WEBP
+    case ChartFormat::WEBP:
+        return encodeWebp(surface, settings.quality, out);
+#endif
+    default:
+        return false;
+    }
+}
+
+bool chartFormatAvailable(ChartFormat format)
+{
+    switch (format)
+    {
+    case ChartFormat::PNG: return true;
+#ifdef HAVE_PNG
+    case ChartFormat::PNG_RGB: return true;
+    case ChartFormat::PNG_PALETTE: return true;
+#endif
+#ifdef HAVE_JPEG
+    case ChartFormat::JPEG: return true;
+#endif
+#ifdef HAVE_WEBP
+    case ChartFormat::WEBP: return true;
+#endif
+    default: return false;
+    }
+}
+
+std::optional<ChartFormat> parseChartFormat(const std::string& name)
+{
+    if (name == "png") return ChartFormat::PNG;
+    if (name == "png-rgb") return ChartFormat::PNG_RGB;
+    if (name == "png-palette") return ChartFormat::PNG_PALETTE;
+    if (name == "jpeg") return ChartFormat::JPEG;
+    if (name == "webp") return ChartFormat::WEBP;
+    return std::nullopt;
+}
+
+std::string chartFormatName(ChartFormat format)
+{
+    switch (format)
+    {
+    case ChartFormat::PNG: return "png";
+    case ChartFormat::PNG_RGB: return "png-rgb";
+    case ChartFormat::PNG_PALETTE: return "png-palette";
+    case ChartFormat::JPEG: return "jpeg";
+    case ChartFormat::WEBP: return "webp";
+    default: return "unknown";
+    }
+}
+
+std::string chartMimeType(ChartFormat format)
+{
+    switch (format)
+    {
+    case ChartFormat::JPEG: return "image/jpeg";
+    case ChartFormat::WEBP: return "image/webp";
+    default: return "image/png";
+    }
+}
+
+std::string chartFileExtension(ChartFormat format)
+{
+    switch (format)
+    {
+    case ChartFormat::JPEG: return "jpg";
+    case ChartFormat::WEBP: return "webp";
+    default: return "png";
+    }
+}
@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../include/ChartRasterizer.hpp"
+
+// Stop colors scaled to 0-255, plus the slope of each segment, so shading a pixel is
+// a clamp, one multiply-add per channel and a select per extra stop.
+struct PreparedPaint
+{
+    int numStops;
+    float firstOffset;
+    float lastOffset;
+    float offset[4];
+    float r[4], g[4], b[4];
+    float dr[4], dg[4], db[4];
+};
+
+static PreparedPaint preparePaint(const RasterPaint& paint)
+{
+    PreparedPaint prepared = {};
+    prepared.numStops = std::max(1, std::min(paint.numStops, 4));
+
+    for (int i = 0; i < prepared.numStops; ++i)
+    {
+        const RasterPaint::Stop& stop = paint.numStops > 0 ? paint.stops[i] : RasterPaint::Stop{0.0f, 0.0f, 0.0f, 0.0f};
+        prepared.offset[i] = stop.offset;
+        prepared.r[i] = stop.r * 255.0f;
+        prepared.g[i] = stop.g * 255.0f;
+        prepared.b[i] = stop.b * 255.0f;
+    }
+
+    for (int i = 0; i + 1 < prepared.numStops; ++i)
+    {
+        float span = std::max(prepared.offset[i + 1] - prepared.offset[i], 1e-6f);
+        prepared.dr[i] = (prepared.r[i + 1] - prepared.r[i]) / span;
+        prepared.dg[i] = (prepared.g[i + 1] - prepared.g[i]) / span;
+        prepared.db[i] = (prepared.b[i + 1] - prepared.b[i]) / span;
+    }
+
+    prepared.firstOffset = prepared.offset[0];
+    prepared.lastOffset = prepared.offset[prepared.numStops - 1];
+
+    return prepared;
+}
+
+static inline uint32_t blendPixel(uint32_t dst, float cover, float r, float g, float b)
+{
+    float keep = 1.0f - cover;
+    float da = static_cast<float>(dst >> 24);
+    float dr = static_cast<float>((dst >> 16) & 0xff);
+    float dg = static_cast<float>((dst >> 8) & 0xff);
+    float db = static_cast<float>(dst & 0xff);
+
+    uint32_t oa = static_cast<uint32_t>(255.0f * cover + da * keep + 0.5f);
+    uint32_t or_ = static_cast<uint32_t>(r * cover + dr * keep + 0.5f);
+    uint32_t og = static_cast<uint32_t>(g * cover + dg * keep + 0.5f);
+    uint32_t ob = static_cast<uint32_t>(b * cover + db * keep + 0.5f);
+
+    return (oa << 24) | (or_ << 16) | (og << 8) | ob;
+}
+
+static void shadeSpan(uint32_t* row, const float* cover, int x0, int x1, float py, const RasterPaint& paint, const PreparedPaint& p)
+{
+    float invRadius = 1.0f / paint.radius;
+    float dy = py - paint.cy;
+    int x = x0;
+
+#ifdef __SSE2__
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 full = _mm_set1_ps(255.0f);
+    const __m128 dy2 = _mm_set1_ps(dy * dy);
+    const __m128 invR = _mm_set1_ps(invRadius);
+    const __m128 tMin = _mm_set1_ps(p.firstOffset);
+    const __m128 tMax = _mm_set1_ps(p.lastOffset);
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+    for (; x + 4 <= x1; x += 4)
+    {
+        __m128 c = _mm_loadu_ps(cover + x);
+        if (_mm_movemask_ps(_mm_cmpgt_ps(c, zero)) == 0)
+        {
+            continue;
+        }
+
+        // Gradient parameter from the distance to the center
+        __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane), _mm_set1_ps(paint.cx));
+        __m128 t = _mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), dy2)), invR);
+        t = _mm_min_ps(_mm_max_ps(t, tMin), tMax);
+
+        __m128 local = _mm_sub_ps(t, _mm_set1_ps(p.offset[0]));
+        __m128 r = _mm_add_ps(_mm_set1_ps(p.r[0]), _mm_mul_ps(local, _mm_set1_ps(p.dr[0])));
+        __m128 g = _mm_add_ps(_mm_set1_ps(p.g[0]), _mm_mul_ps(local, _mm_set1_ps(p.dg[0])));
+        __m128 b = _mm_add_ps(_mm_set1_ps(p.b[0]), _mm_mul_ps(local, _mm_set1_ps(p.db[0])));
+
+        for (int s = 1; s + 1 < p.numStops; ++s)
+        {
+            __m128 inSegment = _mm_cmpge_ps(t, _mm_set1_ps(p.offset[s]));
+            local = _mm_sub_ps(t, _mm_set1_ps(p.offset[s]));
+            __m128 sr = _mm_add_ps(_mm_set1_ps(p.r[s]), _mm_mul_ps(local, _mm_set1_ps(p.dr[s])));
+            __m128 sg = _mm_add_ps(_mm_set1_ps(p.g[s]), _mm_mul_ps(local, _mm_set1_ps(p.dg[s])));
+            __m128 sb = _mm_add_ps(_mm_set1_ps(p.b[s]), _mm_mul_ps(local, _mm_set1_ps(p.db[s])));
+            r = _mm_or_ps(_mm_and_ps(inSegment, sr), _mm_andnot_ps(inSegment, r));
+            g = _mm_or_ps(_mm_and_ps(inSegment, sg), _mm_andnot_ps(inSegment, g));
+            b = _mm_or_ps(_mm_and_ps(inSegment, sb), _mm_andnot_ps(inSegment, b));
+        }
+
+        // out = src * cover + dst * (1 - cover), with an opaque source
+        __m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        __m128 keep = _mm_sub_ps(one, c);
+        __m128 da = _mm_cvtepi32_ps(_mm_srli_epi32(dst, 24));
+        __m128 dr = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(dst, 16), byteMask));
+        __m128 dg = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(dst, 8), byteMask));
+        __m128 db = _mm_cvtepi32_ps(_mm_and_si128(dst, byteMask));
+
+        __m128i oa = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(full, c), _mm_mul_ps(da, keep)));
+        __m128i or_ = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(r, c), _mm_mul_ps(dr, keep)));
+        __m128i og = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(g, c), _mm_mul_ps(dg, keep)));
+        __m128i ob = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(b, c), _mm_mul_ps(db, keep)));
+
+        __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(oa, 24), _mm_slli_epi32(or_, 16)),
+                                   _mm_or_si128(_mm_slli_epi32(og, 8), ob));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), out);
+    }
+#endif
+
+    for (; x < x1; ++x)
+    {
+        float c = cover[x];
+        if (c <= 0.0f)
+        {
+            continue;
+        }
+
+        float dx = x + 0.5f - paint.cx;
+        float t = std::sqrt(dx * dx + dy * dy) * invRadius;
+        t = std::min(std::max(t, p.firstOffset), p.lastOffset);
+
+        int s = 0;
+        while (s + 2 < p.numStops && t >= p.offset[s + 1])
+        {
+            s++;
+        }
+
+        float local = t - p.offset[s];
+        row[x] = blendPixel(row[x], c, p.r[s] + local * p.dr[s], p.g[s] + local * p.dg[s], p.b[s] + local * p.db[s]);
+    }
+}
+
+void ChartRasterizer::prepare(const RasterTarget& target)
+{
+    if (target.width != width || target.height != height)
+    {
+        width = target.width;
+        height = target.height;
+        accumulation.assign(static_cast<size_t>(width + 2) * height, 0.0f);
+        coverage.assign(width + 2, 0.0f);
+    }
+
+    minX = width;
+    maxX = -1;
+    minY = height;
+    maxY = -1;
+}
+
+// Exact-area coverage accumulation: every edge deposits the signed area it covers in
+// each cell, and a running sum along the row yields the coverage of every pixel.
+void ChartRasterizer::accumulateLine(float x0, float y0, float x1, float y1)
+{
+    x0 = std::min(std::max(x0, 0.0f), static_cast<float>(width));
+    x1 = std::min(std::max(x1, 0.0f), static_cast<float>(width));
+    y0 = std::min(std::max(y0, 0.0f), static_cast<float>(height));
+    y1 = std::min(std::max(y1, 0.0f), static_cast<float>(height));
+
+    if (std::fabs(y0 - y1) <= 1e-6f)
+    {
+        return;
+    }
+
+    float dir = 1.0f;
+    if (y0 > y1)
+    {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1.0f;
+    }
+
+    minX = std::min(minX, static_cast<int>(std::floor(std::min(x0, x1))));
+    maxX = std::max(maxX, static_cast<int>(std::ceil(std::max(x0, x1))) + 1);
+    minY = std::min(minY, static_cast<int>(y0));
+    maxY = std::max(maxY, std::min(height, static_cast<int>(std::ceil(y1))));
+
+    const int stride = width + 2;
+    float dxdy = (x1 - x0) / (y1 - y0);
+    float x = x0;
+
+    for (int y = static_cast<int>(y0); y < std::min(height, static_cast<int>(std::ceil(y1))); ++y)
+    {
+        float* line = accumulation.data() + static_cast<size_t>(y) * stride;
+        float dy = std::min(static_cast<float>(y + 1), y1) - std::max(static_cast<float>(y), y0);
+        float xNext = x + dxdy * dy;
+        float d = dy * dir;
+
+        float left = std::min(x, xNext);
+        float right = std::max(x, xNext);
+        float leftFloor = std::floor(left);
+        int leftIndex = static_cast<int>(leftFloor);
+        float rightCeil = std::ceil(right);
+        int rightIndex = static_cast<int>(rightCeil);
+
+        if (rightIndex <= leftIndex + 1)
+        {
+            float xMid = 0.5f * (x + xNext) - leftFloor;
+            line[leftIndex] += d - d * xMid;
+            line[leftIndex + 1] += d * xMid;
+        }
+        else
+        {
+            float s = 1.0f / (right - left);
+            float leftFrac = left - leftFloor;
+            float a0 = 0.5f * s * (1.0f - leftFrac) * (1.0f - leftFrac);
+            float rightFrac = right - rightCeil + 1.0f;
+            float am = 0.5f * s * rightFrac * rightFrac;
+
+            line[leftIndex] += d * a0;
+
+            if (rightIndex == leftIndex + 2)
+            {
+                line[leftIndex + 1] += d * (1.0f - a0 - am);
+            }
+            else
+            {
+                float a1 = s * (1.5f - leftFrac);
+                line[leftIndex + 1] += d * (a1 - a0);
+
+                for (int xi = leftIndex + 2; xi < rightIndex - 1; ++xi)
+                {
+                    line[xi] += d * s;
+                }
+
+                float a2 = a1 + (rightIndex - leftIndex - 3) * s;
+                line[rightIndex - 1] += d * (1.0f - a2 - am);
+            }
+
+            line[rightIndex] += d * am;
+        }
+
+        x = xNext;
+    }
+}
+
+void ChartRasterizer::resolve(RasterTarget& target, const RasterPaint& paint)
+{
+    if (maxX < minX || maxY < minY)
+    {
+        return;
+    }
+
+    PreparedPaint prepared = preparePaint(paint);
+    float opacity = std::min(std::max(paint.opacity, 0.0f), 1.0f);
+    const int stride = width + 2;
+    int spanEnd = std::min(maxX + 1, width + 2);
+
+    for (int y = minY; y < maxY; ++y)
+    {
+        float* line = accumulation.data() + static_cast<size_t>(y) * stride;
+        float sum = 0.0f;
+
+        // Running sum turns the deposited areas into coverage and clears the row for reuse.
+        // A translucent paint is the same blend with its coverage scaled by the opacity.
+        for (int x = minX; x < spanEnd; ++x)
+        {
+            sum += line[x];
+            line[x] = 0.0f;
+            coverage[x] = std::min(std::fabs(sum), 1.0f) * opacity;
+        }
+
+        shadeSpan(target.pixels + static_cast<size_t>(y) * target.stride, coverage.data(), minX, std::min(spanEnd, width), y + 0.5f, paint, prepared);
+    }
+}
+
+void ChartRasterizer::fillPolygon(RasterTarget& target, const float* points, int count, const RasterPaint& paint)
+{
+    prepare(target);
+
+    for (int i = 0; i < count; ++i)
+    {
+        int next = (i + 1) % count;
+        accumulateLine(points[i * 2], points[i * 2 + 1], points[next * 2], points[next * 2 + 1]);
+    }
+
+    resolve(target, paint);
+}
+
+void ChartRasterizer::strokeClosedPolygon(RasterTarget& target, const float* points, int count, float lineWidth, const RasterPaint& paint)
+{
+    prepare(target);
+
+    float halfWidth = lineWidth / 2;
+
+    // Every piece is wound the same way, so overlaps add up instead of cancelling out
+    auto addShape = [this](const float* shape, int shapeCount) {
+        float area = 0.0f;
+        for (int i = 0; i < shapeCount; ++i)
+        {
+            int next = (i + 1) % shapeCount;
+            area += shape[i * 2] * shape[next * 2 + 1] - shape[next * 2] * shape[i * 2 + 1];
+        }
+
+        for (int i = 0; i < shapeCount; ++i)
+        {
+            int from = area >= 0 ? i : (i + 1) % shapeCount;
+            int to = area >= 0 ? (i + 1) % shapeCount : i;
+            accumulateLine(shape[from * 2], shape[from * 2 + 1], shape[to * 2], shape[to * 2 + 1]);
+        }
+    };
+
+    for (int i = 0; i < count; ++i)
+    {
+        int next = (i + 1) % count;
+        float x0 = points[i * 2];
+        float y0 = points[i * 2 + 1];
+        float x1 = points[next * 2];
+        float y1 = points[next * 2 + 1];
+
+        float length = std::sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+        if (length > 1e-6f)
+        {
+            float nx = -(y1 - y0) / length * halfWidth;
+            float ny = (x1 - x0) / length * halfWidth;
+
+            float quad[8] = {x0 + nx, y0 + ny, x1 + nx, y1 + ny, x1 - nx, y1 - ny, x0 - nx, y0 - ny};
+            addShape(quad, 4);
+        }
+
+        // Round the corner with an octagon
+        float join[16];
+        for (int k = 0; k < 8; ++k)
+        {
+            float angle = k * static_cast<float>(M_PI) / 4;
+            join[k * 2] = x1 + halfWidth * std::cos(angle);
+            join[k * 2 + 1] = y1 + halfWidth * std::sin(angle);
+        }
+        addShape(join, 8);
+    }
+
+    resolve(target, paint);
+}
+
+void ChartRasterizer::copy(RasterTarget& target, const uint32_t* src, int srcStride)
+{
+    for (int y = 0; y < target.height; ++y)
+    {
+        std::memcpy(target.pixels + static_cast<size_t>(y) * target.stride, src + static_cast<size_t>(y) * srcStride, target.width * sizeof(uint32_t));
+    }
+}
+
+static inline uint32_t overPixel(uint32_t src, uint32_t dst)
+{
+    uint32_t keep = 255 - (src >> 24);
+    uint32_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        uint32_t product = ((dst >> shift) & 0xff) * keep + 128;
+        out |= (((src >> shift) & 0xff) + ((product + (product >> 8)) >> 8)) << shift;
+    }
+
+    return out;
+}
+
+void ChartRasterizer::compositeOver(RasterTarget& target, const uint32_t* src, int srcStride)
+{
+    for (int y = 0; y < target.height; ++y)
+    {
+        uint32_t* dstRow = target.pixels + static_cast<size_t>(y) * target.stride;
+        const uint32_t* srcRow = src + static_cast<size_t>(y) * srcStride;
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+        const __m128i full = _mm_set1_epi16(255);
+        const __m128i half = _mm_set1_epi16(128);
+
+        for (; x + 4 <= target.width; x += 4)
+        {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcRow + x));
+
+            // Most of the overlay is fully transparent
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff)
+            {
+                continue;
+            }
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), alphaMask)) == 0xffff)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dstRow + x), s);
+                continue;
+            }
+
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dstRow + x));
+
+            __m128i sLo = _mm_unpacklo_epi8(s, zero);
+            __m128i sHi = _mm_unpackhi_epi8(s, zero);
+            __m128i dLo = _mm_unpacklo_epi8(d, zero);
+            __m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+            __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+            // dst * (255 - srcAlpha) / 255, rounded
+            __m128i pLo = _mm_add_epi16(_mm_mullo_epi16(dLo, _mm_sub_epi16(full, aLo)), half);
+            __m128i pHi = _mm_add_epi16(_mm_mullo_epi16(dHi, _mm_sub_epi16(full, aHi)), half);
+            pLo = _mm_srli_epi16(_mm_add_epi16(pLo, _mm_srli_epi16(pLo, 8)), 8);
+            pHi = _mm_srli_epi16(_mm_add_epi16(pHi, _mm_srli_epi16(pHi, 8)), 8);
+
+            __m128i out = _mm_packus_epi16(_mm_add_epi16(sLo, pLo), _mm_add_epi16(sHi, pHi));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dstRow + x), out);
+        }
+#endif
+
+        for (; x < target.width; ++x)
+        {
+            if (srcRow[x] != 0)
+            {
+                dstRow[x] = overPixel(srcRow[x], dstRow[x]);
+            }
+        }
+    }
+}
+
+void ChartRasterizer::drawGlyph(RasterTarget& target, const RasterGlyph& glyph, int penX, int penY)
+{
+    int left = penX + glyph.offsetX;
+    int top = penY + glyph.offsetY;
+
+    for (int gy = 0; gy < glyph.height; ++gy)
+    {
+        int y = top + gy;
+        if (y < 0 || y >= target.height)
+        {
+            continue;
+        }
+
+        uint32_t* row = target.pixels + static_cast<size_t>(y) * target.stride;
+        const uint8_t* mask = glyph.alpha.data() + static_cast<size_t>(gy) * glyph.width;
+
+        for (int gx = 0; gx < glyph.width; ++gx)
+        {
+            int x = left + gx;
+            if (mask[gx] == 0 || x < 0 || x >= target.width)
+            {
+                continue;
+            }
+
+            // Black text: premultiplied source is just the mask in the alpha channel
+            row[x] = overPixel(static_cast<uint32_t>(mask[gx]) << 24, row[x]);
+        }
+    }
+}
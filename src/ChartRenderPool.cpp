@@ -0,0 +1,104 @@
+#include "../include/ChartRenderPool.hpp"
+#include "../include/ChartCache.hpp"
+#include "../include/Logger.hpp"
+
+ChartRenderPool::ChartRenderPool(size_t workerCount, size_t queueCapacity) : jobs(queueCapacity)
+{
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(&ChartRenderPool::workerLoop, this);
+    }
+}
+
+ChartRenderPool::~ChartRenderPool()
+{
+    shutdown();
+}
+
+bool ChartRenderPool::submit(const std::string& chartKey, Render render, Callback onDone)
+{
+    if (!jobs.tryPush(Job{chartKey, std::move(render), std::move(onDone), std::chrono::steady_clock::now()}))
+    {
+        rejected++;
+        return false;
+    }
+
+    return true;
+}
+
+void ChartRenderPool::shutdown()
+{
+    jobs.close();
+
+    for (auto& worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+ChartRenderMetrics ChartRenderPool::getMetrics() const
+{
+    ChartRenderMetrics metrics;
+    size_t count = rendered;
+
+    metrics.queueDepth = jobs.size();
+    metrics.queueCapacity = jobs.getCapacity();
+    metrics.rendered = count;
+    metrics.rejected = rejected;
+    metrics.avgRenderMs = renders > 0 ? totalRenderUs / 1000.0 / renders : 0.0;
+    metrics.maxRenderMs = maxRenderUs / 1000.0;
+    metrics.avgQueueWaitMs = count > 0 ? totalQueueWaitUs / 1000.0 / count : 0.0;
+
+    return metrics;
+}
+
+void ChartRenderPool::workerLoop()
+{
+    while (std::optional<Job> job = jobs.pop())
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        auto waitUs = std::chrono::duration_cast<std::chrono::microseconds>(startTime - job->queuedAt).count();
+
+        // An identical chart may have been rendered while this job was queued
+        std::shared_ptr<const std::string> png = ChartCache::get(job->chartKey);
+
+        if (!png)
+        {
+            try
+            {
+                png = ChartCache::put(job->chartKey, job->render());
+            }
+            catch (std::exception& e)
+            {
+                // Nothing is cached, so the next request for this chart renders it again
+                logger.log(LogLevel::ERROR, "Chart " + job->chartKey + " failed to render: " + e.what());
+                continue;
+            }
+
+            auto renderUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - startTime).count());
+
+            renders++;
+            totalRenderUs += renderUs;
+            uint64_t previousMax = maxRenderUs;
+            while (renderUs > previousMax && !maxRenderUs.compare_exchange_weak(previousMax, renderUs))
+            {
+            }
+        }
+
+        rendered++;
+        totalQueueWaitUs += waitUs;
+
+        try
+        {
+            job->onDone(png);
+        }
+        catch (std::exception& e)
+        {
+            logger.log(LogLevel::ERROR, std::string("Chart render callback failed: ") + e.what());
+        }
+    }
+}
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "../include/ConversationStore.hpp"
+#include "../include/Logger.hpp"
+#include "../include/json.hpp"
+
+// One slot per second; longer deadlines simply stay in their slot for several turns
+static const size_t wheelSlots = 256;
+
+static nlohmann::json stateToJson(const ConversationState& state)
+{
+    if (const auto* rename = std::get_if<AwaitingNewName>(&state))
+    {
+        return {{"step", "awaitingNewName"}, {"previousName", rename->previousName}};
+    }
+    if (std::holds_alternative<AwaitingFriendId>(state))
+    {
+        return {{"step", "awaitingFriendId"}};
+    }
+    return nullptr;
+}
+
+static ConversationState stateFromJson(const nlohmann::json& j)
+{
+    std::string step = j.value("step", "");
+
+    if (step == "awaitingNewName")
+    {
+        return AwaitingNewName{j.value("previousName", "")};
+    }
+    if (step == "awaitingFriendId")
+    {
+        return AwaitingFriendId{};
+    }
+    return std::monostate();
+}
+
+ConversationStore::ConversationStore(std::chrono::seconds ttl, size_t maxEntries, size_t shards)
+    : ttl(ttl), maxEntriesPerShard(std::max<size_t>(1, maxEntries / std::max<size_t>(1, shards)))
+{
+    for (size_t i = 0; i < std::max<size_t>(1, shards); ++i)
+    {
+        this->shards.push_back(std::make_unique<Shard>());
+        this->shards.back()->wheel.resize(wheelSlots);
+    }
+}
+
+int64_t ConversationStore::now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+ConversationStore::Shard& ConversationStore::shardFor(int64_t chatId)
+{
+    return *shards[static_cast<uint64_t>(chatId) % shards.size()];
+}
+
+ConversationState ConversationStore::get(int64_t chatId)
+{
+    Shard& shard = shardFor(chatId);
+    int64_t current = now();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    advance(shard, current);
+
+    auto it = shard.entries.find(chatId);
+    if (it == shard.entries.end() || it->second.deadline <= current)
+    {
+        return std::monostate();
+    }
+    return it->second.state;
+}
+
+void ConversationStore::set(int64_t chatId, ConversationState state)
+{
+    if (std::holds_alternative<std::monostate>(state))
+    {
+        clear(chatId);
+        return;
+    }
+
+    Shard& shard = shardFor(chatId);
+    int64_t current = now();
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        advance(shard, current);
+        insert(shard, chatId, std::move(state), current + ttl.count());
+    }
+    dirty = true;
+}
+
+void ConversationStore::clear(int64_t chatId)
+{
+    Shard& shard = shardFor(chatId);
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.entries.erase(chatId) == 0)
+        {
+            return;
+        }
+    }
+    dirty = true;
+}
+
+void ConversationStore::expire()
+{
+    int64_t current = now();
+
+    for (auto& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        advance(*shard, current);
+    }
+}
+
+// Must be called with the shard locked
+void ConversationStore::insert(Shard& shard, int64_t chatId, ConversationState state, int64_t deadline)
+{
+    auto it = shard.entries.find(chatId);
+
+    if (it == shard.entries.end() && shard.entries.size() >= maxEntriesPerShard)
+    {
+        auto oldest = std::min_element(shard.entries.begin(), shard.entries.end(), [](const auto& a, const auto& b) {
+            return a.second.deadline < b.second.deadline;
+        });
+        shard.entries.erase(oldest);
+        evicted++;
+    }
+
+    if (it == shard.entries.end() || it->second.deadline != deadline)
+    {
+        shard.wheel[static_cast<uint64_t>(deadline) % wheelSlots].push_back(chatId);
+    }
+
+    shard.entries[chatId] = Entry{std::move(state), deadline};
+}
+
+// Turns the wheel up to `until`, dropping the entries whose deadline has passed. Must be
+// called with the shard locked.
+void ConversationStore::advance(Shard& shard, int64_t until)
+{
+    if (shard.tick == 0 || until - shard.tick > static_cast<int64_t>(wheelSlots))
+    {
+        // First use, or idle for a whole turn: every slot is due once
+        shard.tick = until - static_cast<int64_t>(wheelSlots);
+    }
+
+    while (shard.tick < until)
+    {
+        shard.tick++;
+        std::vector<int64_t>& slot = shard.wheel[static_cast<uint64_t>(shard.tick) % wheelSlots];
+
+        auto kept = slot.begin();
+        for (int64_t chatId : slot)
+        {
+            auto it = shard.entries.find(chatId);
+
+            // Ids of cleared or rescheduled chats are left behind in old slots
+            if (it == shard.entries.end() || static_cast<uint64_t>(it->second.deadline) % wheelSlots != static_cast<uint64_t>(shard.tick) % wheelSlots)
+            {
+                continue;
+            }
+
+            if (it->second.deadline <= until)
+            {
+                shard.entries.erase(it);
+                expired++;
+                continue;
+            }
+
+            // Due on a later turn of the wheel
+            *kept++ = chatId;
+        }
+        slot.erase(kept, slot.end());
+    }
+}
+
+void ConversationStore::save(const std::string& path)
+{
+    // Cleared before the snapshot, so a change made while writing is saved next time
+    if (!dirty.exchange(false))
+    {
+        return;
+    }
+
+    nlohmann::json j = nlohmann::json::array();
+    int64_t current = now();
+
+    for (auto& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        for (const auto& [chatId, entry] : shard->entries)
+        {
+            if (entry.deadline > current)
+            {
+                nlohmann::json item = stateToJson(entry.state);
+                item["chatId"] = chatId;
+                item["deadline"] = entry.deadline;
+                j.push_back(item);
+            }
+        }
+    }
+
+    // Written next to the real file and renamed over it, so a crash mid-write leaves the
+    // previous version intact
+    std::string tempPath = path + ".tmp";
+    bool written;
+    {
+        std::ofstream outFile(tempPath);
+        outFile << j.dump(4);
+        written = static_cast<bool>(outFile);
+    }
+
+    std::error_code error;
+    if (written)
+    {
+        std::filesystem::rename(tempPath, path, error);
+    }
+
+    if (!written || error)
+    {
+        logger.log(LogLevel::ERROR, "Can't save conversations to " + path + (error ? ": " + error.message() : ""));
+        // Try again on the next save
+        dirty = true;
+    }
+}
+
+void ConversationStore::load(const std::string& path)
+{
+    std::ifstream inFile(path);
+    if (!inFile)
+    {
+        return;
+    }
+
+    nlohmann::json j;
+    try
+    {
+        inFile >> j;
+    }
+    catch (nlohmann::json::exception& e)
+    {
+        logger.log(LogLevel::ERROR, "Can't read conversations from " + path + ": " + e.what());
+        return;
+    }
+
+    int64_t current = now();
+    size_t loaded = 0;
+
+    for (const auto& item : j)
+    {
+        ConversationState state = stateFromJson(item);
+        int64_t chatId = item.value("chatId", int64_t(0));
+        int64_t deadline = item.value("deadline", int64_t(0));
+
+        if (std::holds_alternative<std::monostate>(state) || deadline <= current)
+        {
+            continue;
+        }
+
+        Shard& shard = shardFor(chatId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        advance(shard, current);
+        insert(shard, chatId, std::move(state), deadline);
+        loaded++;
+    }
+
+    logger.log(LogLevel::INFO, "Restored " + std::to_string(loaded) + " conversations from " + path);
+}
+
+ConversationMetrics ConversationStore::getMetrics() const
+{
+    ConversationMetrics metrics = {};
+
+    for (const auto& shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        metrics.entries += shard->entries.size();
+    }
+
+    metrics.expired = expired;
+    metrics.evicted = evicted;
+
+    return metrics;
+}
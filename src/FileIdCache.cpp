@@ -0,0 +1,126 @@
+#include <fstream>
+#include <filesystem>
+
+#include "../include/FileIdCache.hpp"
+#include "../include/Logger.hpp"
+#include "../include/json.hpp"
+
+std::mutex FileIdCache::cacheMutex;
+std::mutex FileIdCache::fileMutex;
+std::unordered_map<std::string, std::string> FileIdCache::fileIds;
+bool FileIdCache::dirty = false;
+
+static const std::string fileIdsPath = "../data/file_ids.json";
+
+void FileIdCache::loadAll()
+{
+    std::ifstream inFile(fileIdsPath);
+
+    if (!inFile)
+    {
+        return;
+    }
+
+    nlohmann::json j;
+    try
+    {
+        inFile >> j;
+    }
+    catch (nlohmann::json::parse_error& e)
+    {
+        // Only a cache: charts are simply uploaded again
+        logger.log(LogLevel::ERROR, "Can't read file_ids from " + fileIdsPath + ", starting with an empty cache: " + e.what());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (const auto& item : j.items())
+    {
+        if (item.value().is_string())
+        {
+            fileIds[item.key()] = item.value().get<std::string>();
+        }
+    }
+}
+
+void FileIdCache::saveAll()
+{
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+
+    nlohmann::json j = nlohmann::json::object();
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (const auto& pair : fileIds)
+        {
+            j[pair.first] = pair.second;
+        }
+        dirty = false;
+    }
+
+    // Written next to the real file and renamed over it, so a crash mid-write leaves the
+    // previous version intact
+    std::filesystem::create_directories("../data");
+    std::string tempPath = fileIdsPath + ".tmp";
+    bool written;
+    {
+        std::ofstream outFile(tempPath);
+        outFile << j.dump(4);
+        written = static_cast<bool>(outFile);
+    }
+
+    std::error_code error;
+    if (written)
+    {
+        std::filesystem::rename(tempPath, fileIdsPath, error);
+    }
+
+    if (!written || error)
+    {
+        // Try again on the next flush
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        dirty = true;
+    }
+}
+
+bool FileIdCache::saveIfDirty()
+{
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!dirty)
+        {
+            return false;
+        }
+    }
+
+    saveAll();
+    return true;
+}
+
+std::optional<std::string> FileIdCache::get(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = fileIds.find(key);
+    if (it != fileIds.end())
+    {
+        return it->second;
+    }
+
+    return std::nullopt;
+}
+
+void FileIdCache::put(const std::string& key, const std::string& fileId)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    fileIds[key] = fileId;
+    dirty = true;
+}
+
+void FileIdCache::remove(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (fileIds.erase(key) > 0)
+    {
+        dirty = true;
+    }
+}
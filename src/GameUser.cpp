@@ -1,6 +1,64 @@
 #include "../include/GameUser.hpp"
 #include "GameUser.hpp"
 
+#include <cmath>
+#include <functional>
+
+using StatList = std::vector<std::pair<std::string, double>>;
+
+static double statValue(const StatList& stats, const std::string& name)
+{
+    for (const auto& stat : stats)
+    {
+        if (stat.first == name)
+        {
+            return stat.second;
+        }
+    }
+
+    return 0.0;
+}
+
+static double statTotal(const StatList& stats)
+{
+    double total = 0.0;
+
+    for (const auto& stat : stats)
+    {
+        total += stat.second;
+    }
+
+    return total;
+}
+
+// Every derived stat is defined here, in evaluation order.
+static const std::vector<std::pair<std::string, std::function<double(const StatList&)>>> derivedStatFormulas =
+{
+    {"Power", [](const StatList& stats) {
+        return 1.2 * statValue(stats, "Strength") +
+               1.2 * statValue(stats, "Magic") +
+               1.0 * statValue(stats, "Vitality") +
+               1.0 * statValue(stats, "Agility") +
+               0.6 * statValue(stats, "Luck");
+    }},
+    {"Level", [](const StatList& stats) {
+        return std::max(1.0, std::floor((statTotal(stats) - 125.0) / 10.0) + 1.0);
+    }},
+    {"Average", [](const StatList& stats) {
+        return stats.empty() ? 0.0 : statTotal(stats) / stats.size();
+    }}
+};
+
+// Per-stat rank thresholds, highest first.
+static const std::vector<std::pair<double, std::string>> statRankThresholds =
+{
+    {90.0, "S"},
+    {75.0, "A"},
+    {50.0, "B"},
+    {25.0, "C"},
+    {0.0, "D"}
+};
+
 GameUser::GameUser(const std::string& userId, const std::string& gameName, const time_t& regDate) : userId(userId), gameName(gameName), registrationDate(regDate) 
 {
     stats = 
@@ -11,6 +69,8 @@ GameUser::GameUser(const std::string& userId, const std::string& gameName, const
         {"Agility", 25.0},
         {"Luck", 25.0}
     };
+
+    computeDerivedStats();
 }
 
 std::string GameUser::getId() const
@@ -53,6 +113,71 @@ const std::vector<std::string> GameUser::getOutcomingFriendRequests() const
     return outcomingFriendRequests;
 }
 
+const std::vector<std::pair<std::string, double>>& GameUser::getDerivedStats() const
+{
+    return derivedStats;
+}
+
+double GameUser::getDerivedStat(const std::string& name) const
+{
+    return statValue(getDerivedStats(), name);
+}
+
+double GameUser::getPowerScore() const
+{
+    return getDerivedStat("Power");
+}
+
+int GameUser::getLevel() const
+{
+    return static_cast<int>(getDerivedStat("Level"));
+}
+
+std::string GameUser::getStatRank(const std::string& statName) const
+{
+    for (const auto& rank : statRanks)
+    {
+        if (rank.first == statName)
+        {
+            return rank.second;
+        }
+    }
+
+    return "?";
+}
+
+bool GameUser::hasBlockedBot() const
+{
+    return blockedBot;
+}
+
+void GameUser::computeDerivedStats()
+{
+    derivedStats.clear();
+    statRanks.clear();
+
+    for (const auto& formula : derivedStatFormulas)
+    {
+        derivedStats.emplace_back(formula.first, formula.second(stats));
+    }
+
+    for (const auto& stat : stats)
+    {
+        std::string rank = statRankThresholds.back().second;
+
+        for (const auto& threshold : statRankThresholds)
+        {
+            if (stat.second >= threshold.first)
+            {
+                rank = threshold.second;
+                break;
+            }
+        }
+
+        statRanks.emplace_back(stat.first, rank);
+    }
+}
+
 void GameUser::setGameName(const std::string &gameName)
 {
     this->gameName = gameName;
@@ -63,6 +188,30 @@ void GameUser::setUsername(const std::string &username)
     this->username = username;
 }
 
+void GameUser::setStat(const std::string &statName, double value)
+{
+    for (auto& stat : stats)
+    {
+        if (stat.first == statName)
+        {
+            if (stat.second != value)
+            {
+                stat.second = value;
+                computeDerivedStats();
+            }
+            return;
+        }
+    }
+
+    stats.emplace_back(statName, value);
+    computeDerivedStats();
+}
+
+void GameUser::setBlockedBot(bool blocked)
+{
+    blockedBot = blocked;
+}
+
 void GameUser::addFriend(const std::string &friendId)
 {
     if (std::find(friends.begin(), friends.end(), friendId) == friends.end())
@@ -120,7 +269,8 @@ json GameUser::toJson() const
         {"stats", statsJson},
         {"friends", friends},
         {"incomingFriendRequests", incomingFriendRequests},
-        {"outcomingFriendRequests", outcomingFriendRequests}
+        {"outcomingFriendRequests", outcomingFriendRequests},
+        {"blockedBot", blockedBot}
     };
 }
 
@@ -136,6 +286,7 @@ GameUser GameUser::fromJson(const json &j)
     user.friends = j.at("friends").get<std::vector<std::string>>();
     user.incomingFriendRequests = j.at("incomingFriendRequests").get<std::vector<std::string>>();
     user.outcomingFriendRequests = j.at("outcomingFriendRequests").get<std::vector<std::string>>();
+    user.blockedBot = j.value("blockedBot", false);
 
     user.stats.clear();
 
@@ -144,5 +295,7 @@ GameUser GameUser::fromJson(const json &j)
         user.stats.emplace_back(statJson.at("name").get<std::string>(), statJson.at("value").get<double>());
     }
 
+    user.computeDerivedStats();
+
     return user;
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <mutex>
+
+#include "../include/LatencyHistogram.hpp"
+
+std::shared_mutex LatencyRegistry::registryMutex;
+std::map<std::string, std::unique_ptr<LatencyHistogram>> LatencyRegistry::histograms;
+
+// Threads are spread over the shards in the order they first record something
+static size_t threadShard()
+{
+    static std::atomic<size_t> nextThread{0};
+    thread_local size_t shard = nextThread++;
+    return shard;
+}
+
+LatencyHistogram::LatencyHistogram() : shards(new Shard[shardCount])
+{
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t micros)
+{
+    if (micros < subBuckets)
+    {
+        return static_cast<size_t>(micros);
+    }
+
+    int exponent = 63 - __builtin_clzll(micros);
+    if (exponent >= maxExponent)
+    {
+        return bucketCount - 1;
+    }
+
+    size_t subBucket = (micros >> (exponent - subBucketBits)) & (subBuckets - 1);
+    return subBuckets + static_cast<size_t>(exponent - subBucketBits) * subBuckets + subBucket;
+}
+
+// Middle of the bucket's range
+uint64_t LatencyHistogram::bucketValue(size_t index)
+{
+    if (index < subBuckets)
+    {
+        return index;
+    }
+
+    int exponent = static_cast<int>((index - subBuckets) / subBuckets) + subBucketBits;
+    uint64_t subBucket = (index - subBuckets) % subBuckets;
+    uint64_t width = uint64_t(1) << (exponent - subBucketBits);
+
+    return (subBuckets + subBucket) * width + width / 2;
+}
+
+void LatencyHistogram::record(uint64_t micros)
+{
+    Shard& shard = shards[threadShard() % shardCount];
+    shard.counts[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (micros > max && !shard.max.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencySummary LatencyHistogram::summarize(const std::string& name) const
+{
+    std::vector<uint64_t> counts(bucketCount, 0);
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    for (size_t s = 0; s < shardCount; ++s)
+    {
+        for (size_t i = 0; i < bucketCount; ++i)
+        {
+            uint64_t count = shards[s].counts[i].load(std::memory_order_relaxed);
+            counts[i] += count;
+            total += count;
+        }
+        max = std::max(max, shards[s].max.load(std::memory_order_relaxed));
+    }
+
+    auto percentile = [&](double p) -> double {
+        uint64_t rank = static_cast<uint64_t>(p * total + 0.5);
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < bucketCount; ++i)
+        {
+            seen += counts[i];
+            if (seen >= std::max<uint64_t>(1, rank))
+            {
+                return std::min(bucketValue(i), max) / 1000.0;
+            }
+        }
+        return max / 1000.0;
+    };
+
+    return {name, total, percentile(0.50), percentile(0.90), percentile(0.99), max / 1000.0};
+}
+
+LatencyHistogram& LatencyRegistry::get(const std::string& name)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(registryMutex);
+        auto it = histograms.find(name);
+        if (it != histograms.end())
+        {
+            return *it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(registryMutex);
+    std::unique_ptr<LatencyHistogram>& histogram = histograms[name];
+    if (!histogram)
+    {
+        histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *histogram;
+}
+
+std::vector<LatencySummary> LatencyRegistry::summarizeAll()
+{
+    std::shared_lock<std::shared_mutex> lock(registryMutex);
+    std::vector<LatencySummary> summaries;
+
+    for (const auto& [name, histogram] : histograms)
+    {
+        LatencySummary summary = histogram->summarize(name);
+        if (summary.count > 0)
+        {
+            summaries.push_back(summary);
+        }
+    }
+
+    return summaries;
+}
@@ -0,0 +1,958 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include <cairo/cairo.h>
+#include "../include/StatsChart.hpp"
+#include "../include/ChartEncoder.hpp"
+#include "../include/ChartRasterizer.hpp"
+#include "../include/Logger.hpp"
+#include "../include/LatencyHistogram.hpp"
+
+// The chart is laid out on a 500x500 canvas and scaled to the requested size
+static const double baseSize = 500.0;
+static const double maxRadius = 100.0;
+static const double graphCenterX = baseSize / 3.1;
+static const double graphCenterY = baseSize / 2.5;
+static const double centerX = 250.0;
+static const double centerY = 250.0;
+static const double fontSize = 20.0;
+
+static const std::vector<std::tuple<double, double, double>> colors = {
+    {1.0, 0.0, 0.0}, // Red for Attack
+    {0.0, 1.0, 0.0}, // Green for Defense
+    {0.0, 0.0, 1.0}, // Blue for Speed
+    {1.0, 1.0, 0.0}, // Yellow for Luck
+    {1.0, 0.0, 1.0}  // Magenta for Magic
+};
+
+// The friend's polygon on comparison charts: a translucent fill with a solid outline
+static const double compareR = 0.1;
+static const double compareG = 0.45;
+static const double compareB = 0.95;
+static const double compareFillOpacity = 0.45;
+
+// Everything that doesn't depend on stat values, rendered once per stat schema and size.
+// The underlay sits below the stat polygon, the overlay (transparent elsewhere) above it.
+struct ChartLayers
+{
+    cairo_surface_t* underlay;
+    cairo_surface_t* overlay;
+};
+
+static std::mutex layersMutex;
+static std::map<std::string, ChartLayers> layersCache;
+static bool layerCaching = true;
+static std::atomic<ChartBackend> chartBackend(ChartBackend::CAIRO);
+
+// Resolved once per process instead of a fontconfig lookup on every render
+static cairo_font_face_t* chartFontFace()
+{
+    static cairo_font_face_t* fontFace = cairo_toy_font_face_create("Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    return fontFace;
+}
+
+// Everything one render needs at one chart size: surface and context, the scaled font
+// and pre-shaped glyphs for the characters stat values are made of, and the stat gradients
+struct ChartCanvas
+{
+    int size;
+    cairo_surface_t* surface;
+    cairo_t* cr;
+    cairo_scaled_font_t* valueFont;
+    cairo_glyph_t valueGlyphs[128];
+    std::vector<cairo_pattern_t*> statGradients;
+
+    // Used by the software backend only
+    ChartRasterizer rasterizer;
+    RasterGlyph valueMasks[128];
+};
+
+static const char valueChars[] = "0123456789.-/";
+
+// Pre-rasterizes a glyph into a coverage mask for the software backend
+static RasterGlyph rasterizeGlyph(cairo_scaled_font_t* font, const cairo_glyph_t& glyph, const cairo_text_extents_t& extents, int size)
+{
+    double scale = size / baseSize;
+
+    RasterGlyph mask;
+    mask.offsetX = static_cast<int>(std::floor(extents.x_bearing * scale)) - 1;
+    mask.offsetY = static_cast<int>(std::floor(extents.y_bearing * scale)) - 1;
+    mask.width = static_cast<int>(std::ceil((extents.x_bearing + extents.width) * scale)) + 1 - mask.offsetX;
+    mask.height = static_cast<int>(std::ceil((extents.y_bearing + extents.height) * scale)) + 1 - mask.offsetY;
+    mask.advance = extents.x_advance;
+
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_A8, mask.width, mask.height);
+    cairo_t* cr = cairo_create(surface);
+    cairo_translate(cr, -mask.offsetX, -mask.offsetY);
+    cairo_scale(cr, scale, scale);
+    cairo_set_scaled_font(cr, font);
+
+    cairo_glyph_t positioned = {glyph.index, 0.0, 0.0};
+    cairo_show_glyphs(cr, &positioned, 1);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    const unsigned char* data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    mask.alpha.resize(static_cast<size_t>(mask.width) * mask.height);
+    for (int y = 0; y < mask.height; ++y)
+    {
+        std::copy_n(data + static_cast<size_t>(y) * stride, mask.width, mask.alpha.data() + static_cast<size_t>(y) * mask.width);
+    }
+
+    cairo_surface_destroy(surface);
+
+    return mask;
+}
+
+static ChartCanvas* createCanvas(int size)
+{
+    ChartCanvas* canvas = new ChartCanvas;
+    canvas->size = size;
+    canvas->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    canvas->cr = cairo_create(canvas->surface);
+
+    cairo_matrix_t fontMatrix;
+    cairo_matrix_t ctm;
+    cairo_matrix_init_scale(&fontMatrix, fontSize, fontSize);
+    cairo_matrix_init_scale(&ctm, size / baseSize, size / baseSize);
+    cairo_font_options_t* options = cairo_font_options_create();
+    canvas->valueFont = cairo_scaled_font_create(chartFontFace(), &fontMatrix, &ctm, options);
+    cairo_font_options_destroy(options);
+
+    for (cairo_glyph_t& glyph : canvas->valueGlyphs)
+    {
+        glyph = {0, 0.0, 0.0};
+    }
+
+    for (const char* c = valueChars; *c != '\0'; ++c)
+    {
+        cairo_glyph_t* glyphs = nullptr;
+        int numGlyphs = 0;
+
+        if (cairo_scaled_font_text_to_glyphs(canvas->valueFont, 0, 0, c, 1, &glyphs, &numGlyphs, nullptr, nullptr, nullptr) == CAIRO_STATUS_SUCCESS &&
+            numGlyphs == 1)
+        {
+            // The x field holds the advance; positions are filled in per render
+            cairo_text_extents_t extents;
+            cairo_scaled_font_glyph_extents(canvas->valueFont, glyphs, 1, &extents);
+            canvas->valueGlyphs[static_cast<unsigned char>(*c)] = {glyphs[0].index, extents.x_advance, 0.0};
+            canvas->valueMasks[static_cast<unsigned char>(*c)] = rasterizeGlyph(canvas->valueFont, glyphs[0], extents, size);
+        }
+
+        cairo_glyph_free(glyphs);
+    }
+
+    for (const auto& color : colors)
+    {
+        double r = std::get<0>(color);
+        double g = std::get<1>(color);
+        double b = std::get<2>(color);
+
+        // Create a radial gradient
+        cairo_pattern_t *gradient = cairo_pattern_create_radial(
+            graphCenterX, graphCenterY, 0,  // Inner circle (start of gradient)
+            graphCenterX, graphCenterY, maxRadius  // Outer circle (end of gradient)
+        );
+
+        // Add color stops to the gradient
+        cairo_pattern_add_color_stop_rgba(gradient, 0, r, g, b, 1.0);  // Full color at center
+        cairo_pattern_add_color_stop_rgba(gradient, 0.7, r * 0.7, g * 0.7, b * 0.7, 1.0);  // Darker mid-point
+        cairo_pattern_add_color_stop_rgba(gradient, 1, r * 0.4, g * 0.4, b * 0.4, 1.0);  // Even darker at edges
+
+        canvas->statGradients.push_back(gradient);
+    }
+
+    return canvas;
+}
+
+static void destroyCanvas(ChartCanvas* canvas)
+{
+    for (cairo_pattern_t* gradient : canvas->statGradients)
+    {
+        cairo_pattern_destroy(gradient);
+    }
+
+    cairo_scaled_font_destroy(canvas->valueFont);
+    cairo_destroy(canvas->cr);
+    cairo_surface_destroy(canvas->surface);
+    delete canvas;
+}
+
+// Idle canvases shared by every rendering thread. Up to poolLimit canvases are kept
+// between renders; any beyond that are destroyed when released.
+static std::mutex poolMutex;
+static std::map<int, std::vector<ChartCanvas*>> idleCanvases;
+static size_t idleCount = 0;
+static size_t poolLimit = 16;
+static ChartPoolMetrics poolMetrics = {};
+
+static ChartCanvas* acquireCanvas(int size)
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        poolMetrics.acquired++;
+
+        auto& idle = idleCanvases[size];
+        if (!idle.empty())
+        {
+            ChartCanvas* canvas = idle.back();
+            idle.pop_back();
+            idleCount--;
+            poolMetrics.reused++;
+            return canvas;
+        }
+
+        poolMetrics.created++;
+    }
+
+    return createCanvas(size);
+}
+
+static void releaseCanvas(ChartCanvas* canvas)
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+
+        if (idleCount < poolLimit)
+        {
+            idleCanvases[canvas->size].push_back(canvas);
+            idleCount++;
+            return;
+        }
+
+        poolMetrics.discarded++;
+    }
+
+    destroyCanvas(canvas);
+}
+
+void setStatsChartPoolLimit(size_t maxIdleCanvases)
+{
+    std::vector<ChartCanvas*> evicted;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        poolLimit = maxIdleCanvases;
+
+        for (auto& entry : idleCanvases)
+        {
+            while (idleCount > poolLimit && !entry.second.empty())
+            {
+                evicted.push_back(entry.second.back());
+                entry.second.pop_back();
+                idleCount--;
+                poolMetrics.discarded++;
+            }
+        }
+    }
+
+    for (ChartCanvas* canvas : evicted)
+    {
+        destroyCanvas(canvas);
+    }
+}
+
+ChartPoolMetrics getStatsChartPoolMetrics()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    ChartPoolMetrics metrics = poolMetrics;
+    metrics.idle = idleCount;
+    metrics.limit = poolLimit;
+    return metrics;
+}
+
+double degreesToRadians(double degrees) { return degrees * M_PI / 180.0; }
+
+static std::string layersKey(const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    std::string key = std::to_string(size);
+
+    for (const auto& stat : stats)
+    {
+        key += "|" + stat.first;
+    }
+
+    return key;
+}
+
+static cairo_t* createScaledContext(cairo_surface_t* surface, int size)
+{
+    cairo_t* cr = cairo_create(surface);
+    cairo_scale(cr, size / baseSize, size / baseSize);
+    cairo_set_font_face(cr, chartFontFace());
+    cairo_set_font_size(cr, fontSize);
+    return cr;
+}
+
+static ChartLayers renderLayers(const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    int numStats = stats.size();
+    double angleStep = 2 * M_PI / numStats; // Angle between each stat
+
+    ChartLayers layers;
+
+    // Underlay: background gradient and axis labels
+    layers.underlay = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cairo_t* cr = createScaledContext(layers.underlay, size);
+
+    cairo_pattern_t* bgGradient = cairo_pattern_create_radial(
+        baseSize / 2, baseSize / 2, 0,  // Inner circle (start of gradient)
+        baseSize / 2, baseSize / 2, 500  // Outer circle (end of gradient)
+    );
+
+    cairo_pattern_add_color_stop_rgba(bgGradient, 0.0, 1.0, 1.0, 1.0, 1.0);  // Full color at center
+    cairo_pattern_add_color_stop_rgba(bgGradient, 1.0, 0.0, 0.0, 0.0, 1.0);  // Darker mid-point
+
+    cairo_set_source(cr, bgGradient);
+
+    cairo_paint(cr);
+
+    cairo_pattern_destroy(bgGradient);
+
+    for (int i = 0; i < numStats; ++i) {
+        double angle = -M_PI / 2 + i * angleStep;
+        double labelRadius = maxRadius + 20; // Place labels slightly outside the chart
+        double x = graphCenterX + labelRadius * cos(angle);
+        double y = graphCenterY + labelRadius * sin(angle);
+
+        // Get the label text
+        const std::string& label = stats[i].first;
+
+        // Calculate text extents
+        cairo_text_extents_t extents;
+        cairo_text_extents(cr, label.c_str(), &extents);
+
+        // Adjust position of the label
+        double textX, textY;
+        if (cos(angle) < 0) {
+            textX = x - extents.width;
+        } else {
+            textX = x;
+        }
+        if (sin(angle) < 0) {
+            textY = y;
+        } else {
+            textY = y + extents.height;
+        }
+
+        // Set color to black for the text
+        cairo_set_source_rgb(cr, 0, 0, 0);
+
+        // Draw the text
+        cairo_move_to(cr, textX, textY);
+        cairo_show_text(cr, label.c_str());
+    }
+
+    cairo_destroy(cr);
+    cairo_surface_flush(layers.underlay);
+
+    // Overlay: grid, title and stat names
+    layers.overlay = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cr = createScaledContext(layers.overlay, size);
+
+    // Draw the grid lines and background
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0); // Black color
+    cairo_set_line_width(cr, 1.0);
+    for (int i = 0; i < numStats; ++i) {
+        double angle = -M_PI / 2 + i * angleStep;
+        double x = graphCenterX + maxRadius * cos(angle);
+        double y = graphCenterY + maxRadius * sin(angle);
+
+        cairo_move_to(cr, graphCenterX, graphCenterY);
+        cairo_line_to(cr, x, y);
+        cairo_stroke(cr);
+    }
+
+    // Draw concentric polygons (grid)
+    for (int i = 1; i <= 4; ++i) {
+        double radius = maxRadius * i / 4;
+        double startAngle = -M_PI / 2; // Starting angle for the first vertex
+
+        cairo_move_to(cr, graphCenterX + radius * cos(startAngle), graphCenterY + radius * sin(startAngle));
+        for (int j = 1; j < numStats; ++j) {
+            double angle = startAngle + j * angleStep;
+            cairo_line_to(cr, graphCenterX + radius * cos(angle), graphCenterY + radius * sin(angle));
+        }
+        cairo_close_path(cr);
+        cairo_stroke(cr);
+    }
+
+    cairo_set_font_size(cr, fontSize * 2);
+
+    cairo_move_to(cr, centerX - (centerX / 4), 40);
+    cairo_show_text(cr, "STATS");
+
+    cairo_set_font_size(cr, fontSize);
+
+    double statsTextNameX = centerX + (centerX / 2.7);
+    double statsTextNameY = centerY / 1.8;
+
+    for (const auto& stat : stats)
+    {
+        std::string name = stat.first + ":";
+
+        cairo_move_to(cr, statsTextNameX, statsTextNameY);
+        cairo_show_text(cr, name.c_str());
+
+        statsTextNameY += 30;
+    }
+
+    cairo_destroy(cr);
+    cairo_surface_flush(layers.overlay);
+
+    return layers;
+}
+
+// Underlay plus user polygon of recent comparison charts, keyed by statsChartKey, so
+// comparing one user with several friends draws and composites only the friend's side.
+// Most recently used first; each entry is a full canvas, so only a few are kept.
+static std::mutex comparisonBaseMutex;
+static std::list<std::pair<std::string, cairo_surface_t*>> comparisonBases;
+static const size_t comparisonBaseLimit = 8;
+
+static void copyPixels(cairo_surface_t* from, cairo_surface_t* to)
+{
+    cairo_surface_flush(from);
+    cairo_surface_flush(to);
+    std::memcpy(cairo_image_surface_get_data(to), cairo_image_surface_get_data(from),
+                static_cast<size_t>(cairo_image_surface_get_stride(from)) * cairo_image_surface_get_height(from));
+    cairo_surface_mark_dirty(to);
+}
+
+static bool loadComparisonBase(const std::string& key, ChartCanvas* canvas)
+{
+    std::lock_guard<std::mutex> lock(comparisonBaseMutex);
+
+    for (auto it = comparisonBases.begin(); it != comparisonBases.end(); ++it)
+    {
+        if (it->first == key)
+        {
+            comparisonBases.splice(comparisonBases.begin(), comparisonBases, it);
+            copyPixels(it->second, canvas->surface);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void storeComparisonBase(const std::string& key, ChartCanvas* canvas)
+{
+    cairo_surface_t* base = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, canvas->size, canvas->size);
+    copyPixels(canvas->surface, base);
+
+    std::lock_guard<std::mutex> lock(comparisonBaseMutex);
+
+    comparisonBases.emplace_front(key, base);
+    if (comparisonBases.size() > comparisonBaseLimit)
+    {
+        cairo_surface_destroy(comparisonBases.back().second);
+        comparisonBases.pop_back();
+    }
+}
+
+static void clearComparisonBases()
+{
+    std::lock_guard<std::mutex> lock(comparisonBaseMutex);
+
+    for (auto& entry : comparisonBases)
+    {
+        cairo_surface_destroy(entry.second);
+    }
+    comparisonBases.clear();
+}
+
+static void destroyLayers(ChartLayers& layers)
+{
+    cairo_surface_destroy(layers.underlay);
+    cairo_surface_destroy(layers.overlay);
+}
+
+static ChartLayers getLayers(const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    std::string key = layersKey(stats, size);
+
+    std::lock_guard<std::mutex> lock(layersMutex);
+
+    auto it = layersCache.find(key);
+    if (it != layersCache.end())
+    {
+        return it->second;
+    }
+
+    ChartLayers layers = renderLayers(stats, size);
+    layersCache[key] = layers;
+    return layers;
+}
+
+void warmStatsChartLayers(const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    getLayers(stats, size);
+}
+
+void setStatsChartLayerCaching(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(layersMutex);
+
+    layerCaching = enabled;
+
+    if (!enabled)
+    {
+        for (auto& entry : layersCache)
+        {
+            destroyLayers(entry.second);
+        }
+        layersCache.clear();
+        clearComparisonBases();
+    }
+}
+
+// The value column shows "user/friend" on comparison charts
+static int formatStatValue(char* out, size_t length, double value, const std::vector<double>* friendValues, int index)
+{
+    if (friendValues != nullptr)
+    {
+        return snprintf(out, length, "%.0f/%.0f", value, (*friendValues)[index]);
+    }
+
+    return snprintf(out, length, "%.1f", value);
+}
+
+// Values are right-aligned against this edge, so "100/100" stays on the chart
+static const double statsTextValueRight = baseSize - 10.0;
+
+// Underlay and the user's stat polygon: everything a comparison chart shares with the
+// user's own chart
+static void drawStatPolygonCairo(ChartCanvas* canvas, const ChartLayers& layers, const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    int numStats = stats.size();
+    double angleStep = 2 * M_PI / numStats; // Angle between each stat
+
+    cairo_t* cr = canvas->cr;
+
+    cairo_save(cr);
+    cairo_new_path(cr);
+
+    // Blit the static background, then work in layout coordinates
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, layers.underlay, 0, 0);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    cairo_scale(cr, size / baseSize, size / baseSize);
+
+    // Draw the radar chart area with stats
+    thread_local std::vector<std::pair<double, double>> points;
+    points.clear();
+    cairo_set_line_width(cr, 2.0);
+    for (int i = 0; i < numStats; ++i) {
+        double angle = -M_PI / 2 + i * angleStep;
+        double value = stats[i].second;
+        double x = graphCenterX + (value / 100.0) * maxRadius * cos(angle);
+        double y = graphCenterY + (value / 100.0) * maxRadius * sin(angle);
+
+        // Set the stat's gradient as the source
+        cairo_set_source(cr, canvas->statGradients[i % canvas->statGradients.size()]);
+
+        // Draw a triangle for the current stat
+        cairo_move_to(cr, graphCenterX, graphCenterY);
+        cairo_line_to(cr, x, y);
+
+        // Calculate the next point
+        int nextIndex = (i + 1) % numStats;
+        double nextAngle = -M_PI / 2 + nextIndex * angleStep;
+        double nextValue = stats[nextIndex].second;
+        double nextX = graphCenterX + (nextValue / 100.0) * maxRadius * cos(nextAngle);
+        double nextY = graphCenterY + (nextValue / 100.0) * maxRadius * sin(nextAngle);
+
+        cairo_line_to(cr, nextX, nextY);
+        cairo_close_path(cr);
+        cairo_fill(cr);
+
+        points.emplace_back(x, y);
+    }
+
+    // Draw the lines connecting the stats
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0); // Black color
+    cairo_set_line_width(cr, 2.0);
+    cairo_move_to(cr, points[0].first, points[0].second);
+    for (int i = 1; i < numStats; ++i) {
+        cairo_line_to(cr, points[i].first, points[i].second);
+    }
+    cairo_close_path(cr);
+    cairo_stroke(cr);
+
+    cairo_restore(cr);
+    cairo_surface_flush(canvas->surface);
+}
+
+// The friend's polygon, if any, then the overlay and the value column
+static void drawChartTopCairo(ChartCanvas* canvas, const ChartLayers& layers, const std::vector<std::pair<std::string, double>>& stats,
+                              const std::vector<double>* friendValues, int size)
+{
+    int numStats = stats.size();
+    double angleStep = 2 * M_PI / numStats; // Angle between each stat
+
+    cairo_t* cr = canvas->cr;
+
+    cairo_save(cr);
+    cairo_new_path(cr);
+    cairo_scale(cr, size / baseSize, size / baseSize);
+    cairo_set_scaled_font(cr, canvas->valueFont);
+    cairo_set_line_width(cr, 2.0);
+
+    if (friendValues != nullptr)
+    {
+        for (int i = 0; i < numStats; ++i) {
+            double angle = -M_PI / 2 + i * angleStep;
+            double value = (*friendValues)[i];
+            double x = graphCenterX + (value / 100.0) * maxRadius * cos(angle);
+            double y = graphCenterY + (value / 100.0) * maxRadius * sin(angle);
+
+            if (i == 0)
+            {
+                cairo_move_to(cr, x, y);
+            }
+            else
+            {
+                cairo_line_to(cr, x, y);
+            }
+        }
+        cairo_close_path(cr);
+
+        cairo_set_source_rgba(cr, compareR, compareG, compareB, compareFillOpacity);
+        cairo_fill_preserve(cr);
+        cairo_set_source_rgb(cr, compareR, compareG, compareB);
+        cairo_stroke(cr);
+    }
+
+    // Grid, title and stat names go on top of the polygon
+    cairo_save(cr);
+    cairo_identity_matrix(cr);
+    cairo_set_source_surface(cr, layers.overlay, 0, 0);
+    cairo_paint(cr);
+    cairo_restore(cr);
+
+    double statsTextValueY = centerY / 1.8;
+
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+
+    // Values are laid out from the pre-shaped glyphs, no text shaping per render
+    for (int s = 0; s < numStats; ++s)
+    {
+        char value[32];
+        int length = std::min(formatStatValue(value, sizeof(value), stats[s].second, friendValues, s), static_cast<int>(sizeof(value)) - 1);
+
+        double width = 0.0;
+        for (int i = 0; i < length; ++i)
+        {
+            width += canvas->valueGlyphs[static_cast<unsigned char>(value[i]) & 0x7f].x;
+        }
+
+        cairo_glyph_t run[sizeof(value)];
+        int numGlyphs = 0;
+        double x = statsTextValueRight - width;
+
+        for (int i = 0; i < length; ++i)
+        {
+            const cairo_glyph_t& glyph = canvas->valueGlyphs[static_cast<unsigned char>(value[i]) & 0x7f];
+            run[numGlyphs++] = {glyph.index, x, statsTextValueY};
+            x += glyph.x;
+        }
+
+        cairo_show_glyphs(cr, run, numGlyphs);
+
+        statsTextValueY += 30;
+    }
+
+    cairo_restore(cr);
+    cairo_surface_flush(canvas->surface);
+}
+
+static RasterTarget canvasTarget(ChartCanvas* canvas, int size)
+{
+    RasterTarget target;
+    target.pixels = reinterpret_cast<uint32_t*>(cairo_image_surface_get_data(canvas->surface));
+    target.width = size;
+    target.height = size;
+    target.stride = cairo_image_surface_get_stride(canvas->surface) / 4;
+    return target;
+}
+
+// Same pictures as the Cairo functions above, drawn straight into the surface's pixels
+static void drawStatPolygonSoftware(ChartCanvas* canvas, const ChartLayers& layers, const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    int numStats = stats.size();
+    double angleStep = 2 * M_PI / numStats; // Angle between each stat
+    float scale = static_cast<float>(size / baseSize);
+
+    cairo_surface_flush(canvas->surface);
+    RasterTarget target = canvasTarget(canvas, size);
+
+    ChartRasterizer::copy(target, reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(layers.underlay)),
+                          cairo_image_surface_get_stride(layers.underlay) / 4);
+
+    // Polygon vertices in device pixels
+    thread_local std::vector<float> points;
+    points.clear();
+    for (int i = 0; i < numStats; ++i) {
+        double angle = -M_PI / 2 + i * angleStep;
+        double value = stats[i].second;
+        points.push_back(static_cast<float>((graphCenterX + (value / 100.0) * maxRadius * cos(angle)) * scale));
+        points.push_back(static_cast<float>((graphCenterY + (value / 100.0) * maxRadius * sin(angle)) * scale));
+    }
+
+    float centerPx = static_cast<float>(graphCenterX) * scale;
+    float centerPy = static_cast<float>(graphCenterY) * scale;
+
+    for (int i = 0; i < numStats; ++i) {
+        int nextIndex = (i + 1) % numStats;
+        float triangle[6] = {centerPx, centerPy, points[i * 2], points[i * 2 + 1], points[nextIndex * 2], points[nextIndex * 2 + 1]};
+
+        const auto& color = colors[i % colors.size()];
+        float r = static_cast<float>(std::get<0>(color));
+        float g = static_cast<float>(std::get<1>(color));
+        float b = static_cast<float>(std::get<2>(color));
+
+        RasterPaint paint;
+        paint.cx = centerPx;
+        paint.cy = centerPy;
+        paint.radius = static_cast<float>(maxRadius) * scale;
+        paint.stops[0] = {0.0f, r, g, b};
+        paint.stops[1] = {0.7f, r * 0.7f, g * 0.7f, b * 0.7f};
+        paint.stops[2] = {1.0f, r * 0.4f, g * 0.4f, b * 0.4f};
+        paint.numStops = 3;
+
+        canvas->rasterizer.fillPolygon(target, triangle, 3, paint);
+    }
+
+    RasterPaint black;
+    black.stops[0] = {0.0f, 0.0f, 0.0f, 0.0f};
+    black.numStops = 1;
+    canvas->rasterizer.strokeClosedPolygon(target, points.data(), numStats, 2.0f * scale, black);
+
+    cairo_surface_mark_dirty(canvas->surface);
+}
+
+static void drawChartTopSoftware(ChartCanvas* canvas, const ChartLayers& layers, const std::vector<std::pair<std::string, double>>& stats,
+                                 const std::vector<double>* friendValues, int size)
+{
+    int numStats = stats.size();
+    double angleStep = 2 * M_PI / numStats; // Angle between each stat
+    float scale = static_cast<float>(size / baseSize);
+
+    cairo_surface_flush(canvas->surface);
+    RasterTarget target = canvasTarget(canvas, size);
+
+    if (friendValues != nullptr)
+    {
+        thread_local std::vector<float> friendPoints;
+        friendPoints.clear();
+        for (int i = 0; i < numStats; ++i) {
+            double angle = -M_PI / 2 + i * angleStep;
+            double value = (*friendValues)[i];
+            friendPoints.push_back(static_cast<float>((graphCenterX + (value / 100.0) * maxRadius * cos(angle)) * scale));
+            friendPoints.push_back(static_cast<float>((graphCenterY + (value / 100.0) * maxRadius * sin(angle)) * scale));
+        }
+
+        RasterPaint friendPaint;
+        friendPaint.stops[0] = {0.0f, static_cast<float>(compareR), static_cast<float>(compareG), static_cast<float>(compareB)};
+        friendPaint.numStops = 1;
+        friendPaint.opacity = static_cast<float>(compareFillOpacity);
+        canvas->rasterizer.fillPolygon(target, friendPoints.data(), numStats, friendPaint);
+
+        friendPaint.opacity = 1.0f;
+        canvas->rasterizer.strokeClosedPolygon(target, friendPoints.data(), numStats, 2.0f * scale, friendPaint);
+    }
+
+    ChartRasterizer::compositeOver(target, reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(layers.overlay)),
+                                   cairo_image_surface_get_stride(layers.overlay) / 4);
+
+    double statsTextValueY = centerY / 1.8;
+
+    for (int s = 0; s < numStats; ++s)
+    {
+        char value[32];
+        int length = std::min(formatStatValue(value, sizeof(value), stats[s].second, friendValues, s), static_cast<int>(sizeof(value)) - 1);
+
+        double width = 0.0;
+        for (int i = 0; i < length; ++i)
+        {
+            width += canvas->valueMasks[static_cast<unsigned char>(value[i]) & 0x7f].advance;
+        }
+
+        double x = statsTextValueRight - width;
+
+        for (int i = 0; i < length; ++i)
+        {
+            const RasterGlyph& glyph = canvas->valueMasks[static_cast<unsigned char>(value[i]) & 0x7f];
+            ChartRasterizer::drawGlyph(target, glyph, static_cast<int>(std::lround(x * scale)), static_cast<int>(std::lround(statsTextValueY * scale)));
+            x += glyph.advance;
+        }
+
+        statsTextValueY += 30;
+    }
+
+    cairo_surface_mark_dirty(canvas->surface);
+}
+
+void setStatsChartBackend(ChartBackend backend)
+{
+    chartBackend = backend;
+}
+
+ChartBackend getStatsChartBackend()
+{
+    return chartBackend;
+}
+
+static const std::string& renderChart(const std::vector<std::pair<std::string, double>>& stats, const std::vector<double>* friendValues, int size)
+{
+    static LatencyHistogram& statsLatency = LatencyRegistry::get("chart drawStatsChart");
+    static LatencyHistogram& comparisonLatency = LatencyRegistry::get("chart drawComparisonChart");
+    LatencyTimer timer(friendValues != nullptr ? comparisonLatency : statsLatency);
+
+    // Reused across calls on the same thread so encoding doesn't regrow a fresh buffer each time
+    thread_local std::string imageBuffer;
+
+    bool cached;
+    {
+        std::lock_guard<std::mutex> lock(layersMutex);
+        cached = layerCaching;
+    }
+
+    ChartLayers layers = cached ? getLayers(stats, size) : renderLayers(stats, size);
+
+    // Reuse a pooled surface and context; the underlay (or a stored base) overwrites every pixel
+    ChartCanvas* canvas = acquireCanvas(size);
+    bool software = chartBackend == ChartBackend::SOFTWARE;
+
+    std::string baseKey = friendValues != nullptr && cached ? statsChartKey(stats, size) : "";
+
+    if (baseKey.empty() || !loadComparisonBase(baseKey, canvas))
+    {
+        if (software)
+        {
+            drawStatPolygonSoftware(canvas, layers, stats, size);
+        }
+        else
+        {
+            drawStatPolygonCairo(canvas, layers, stats, size);
+        }
+
+        if (!baseKey.empty())
+        {
+            storeComparisonBase(baseKey, canvas);
+        }
+    }
+
+    if (software)
+    {
+        drawChartTopSoftware(canvas, layers, stats, friendValues, size);
+    }
+    else
+    {
+        drawChartTopCairo(canvas, layers, stats, friendValues, size);
+    }
+
+    // Encode the image straight into memory
+    bool encoded = encodeChart(canvas->surface, getChartEncoderSettings(), imageBuffer);
+
+    releaseCanvas(canvas);
+
+    if (!cached)
+    {
+        destroyLayers(layers);
+    }
+
+    // An empty buffer must never reach ChartCache or be uploaded as a photo
+    if (!encoded)
+    {
+        logger.log(LogLevel::ERROR, "Failed to encode stats chart");
+        throw std::runtime_error("Failed to encode stats chart");
+    }
+
+    return imageBuffer;
+}
+
+const std::string& drawStatsChart(const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    return renderChart(stats, nullptr, size);
+}
+
+const std::string& drawComparisonChart(const std::vector<std::pair<std::string, double>>& stats,
+                                       const std::vector<std::pair<std::string, double>>& friendStats, int size)
+{
+    // Friend values are matched to the user's axes by name; missing stats plot at zero
+    thread_local std::vector<double> friendValues;
+    friendValues.assign(stats.size(), 0.0);
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        for (const auto& stat : friendStats)
+        {
+            if (stat.first == stats[i].first)
+            {
+                friendValues[i] = stat.second;
+                break;
+            }
+        }
+    }
+
+    return renderChart(stats, &friendValues, size);
+}
+
+std::string statsChartKey(const std::vector<std::pair<std::string, double>>& stats, int size)
+{
+    // FNV-1a over the layout version, the size, the encoder settings, the backend and the full stat vector
+    uint64_t hash = 1469598103934665603ULL;
+
+    auto mix = [&hash](const void* data, size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    mix(&chartLayoutVersion, sizeof(chartLayoutVersion));
+    mix(&size, sizeof(size));
+
+    ChartEncoderSettings encoder = getChartEncoderSettings();
+    mix(&encoder.format, sizeof(encoder.format));
+    mix(&encoder.zlibLevel, sizeof(encoder.zlibLevel));
+    mix(&encoder.quality, sizeof(encoder.quality));
+
+    ChartBackend backend = chartBackend;
+    mix(&backend, sizeof(backend));
+
+    for (const auto& stat : stats)
+    {
+        mix(stat.first.data(), stat.first.size() + 1);
+        mix(&stat.second, sizeof(stat.second));
+    }
+
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return oss.str();
+}
+
+std::string comparisonChartKey(const std::vector<std::pair<std::string, double>>& stats,
+                               const std::vector<std::pair<std::string, double>>& friendStats, int size)
+{
+    // Ordered pair of the two single-chart keys, which already cover layout, size and encoding
+    return statsChartKey(stats, size) + statsChartKey(friendStats, size);
+}
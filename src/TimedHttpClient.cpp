@@ -0,0 +1,26 @@
+#include "../include/TimedHttpClient.hpp"
+#include "../include/LatencyHistogram.hpp"
+
+TimedHttpClient::TimedHttpClient(const TgBot::HttpClient& client) : client(client)
+{
+    _timeout = client._timeout;
+}
+
+std::string TimedHttpClient::makeRequest(const TgBot::Url& url, const std::vector<TgBot::HttpReqArg>& args) const
+{
+    // The path ends with the method name: /bot<token>/<method>
+    LatencyTimer timer("api " + url.path.substr(url.path.find_last_of('/') + 1));
+    return client.makeRequest(url, args);
+}
+
+int TimedHttpClient::getRequestMaxRetries() const
+{
+    // The library's own retries resend a 429 right away, ignoring retry_after, and
+    // hold a sender thread for their backoff sleeps
+    return 0;
+}
+
+int TimedHttpClient::getRequestBackoff() const
+{
+    return client.getRequestBackoff();
+}
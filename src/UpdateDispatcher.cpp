@@ -0,0 +1,115 @@
+#include <algorithm>
+
+#include "../include/UpdateDispatcher.hpp"
+#include "../include/Logger.hpp"
+
+using namespace TgBot;
+
+UpdateDispatcher::UpdateDispatcher(const EventHandler& handler, size_t workers, size_t queueCapacity) : handler(handler)
+{
+    for (size_t i = 0; i < std::max<size_t>(1, workers); ++i)
+    {
+        shards.push_back(std::make_unique<Shard>(queueCapacity));
+    }
+
+    for (auto& shard : shards)
+    {
+        shard->worker = std::thread(&UpdateDispatcher::workerLoop, this, std::ref(*shard));
+    }
+}
+
+UpdateDispatcher::~UpdateDispatcher()
+{
+    shutdown();
+}
+
+int64_t UpdateDispatcher::chatIdOf(const Update::Ptr& update)
+{
+    if (update->message != nullptr)
+    {
+        return update->message->chat->id;
+    }
+    if (update->editedMessage != nullptr)
+    {
+        return update->editedMessage->chat->id;
+    }
+    if (update->callbackQuery != nullptr)
+    {
+        // Buttons on the bot's own messages; the private chat id is the user id
+        return update->callbackQuery->message != nullptr ? update->callbackQuery->message->chat->id : update->callbackQuery->from->id;
+    }
+    if (update->myChatMember != nullptr)
+    {
+        return update->myChatMember->chat->id;
+    }
+    if (update->chatMember != nullptr)
+    {
+        return update->chatMember->chat->id;
+    }
+
+    return 0;
+}
+
+bool UpdateDispatcher::dispatch(const Update::Ptr& update)
+{
+    uint64_t chatId = static_cast<uint64_t>(chatIdOf(update));
+    Shard& shard = *shards[chatId % shards.size()];
+
+    if (!shard.updates.push(update))
+    {
+        return false;
+    }
+
+    size_t depth = shard.updates.size();
+    size_t previousMax = shard.maxQueueDepth;
+    while (depth > previousMax && !shard.maxQueueDepth.compare_exchange_weak(previousMax, depth))
+    {
+    }
+
+    return true;
+}
+
+void UpdateDispatcher::shutdown()
+{
+    for (auto& shard : shards)
+    {
+        shard->updates.close();
+    }
+
+    for (auto& shard : shards)
+    {
+        if (shard->worker.joinable())
+        {
+            shard->worker.join();
+        }
+    }
+}
+
+std::vector<UpdateShardMetrics> UpdateDispatcher::getMetrics() const
+{
+    std::vector<UpdateShardMetrics> metrics;
+
+    for (const auto& shard : shards)
+    {
+        metrics.push_back({shard->updates.size(), shard->maxQueueDepth, shard->updates.getCapacity(), shard->handled});
+    }
+
+    return metrics;
+}
+
+void UpdateDispatcher::workerLoop(Shard& shard)
+{
+    while (std::optional<Update::Ptr> update = shard.updates.pop())
+    {
+        try
+        {
+            handler.handleUpdate(*update);
+        }
+        catch (std::exception& e)
+        {
+            logger.log(LogLevel::ERROR, "Update " + std::to_string((*update)->updateId) + " failed: " + e.what());
+        }
+
+        shard.handled++;
+    }
+}
@@ -2,10 +2,16 @@
 
 #include "../include/UserManager.hpp"
 #include "../include/json.hpp"
+#include "../include/LatencyHistogram.hpp"
 
 std::unordered_map<std::string, GameUser> UserManager::usersCache;
+std::recursive_mutex UserManager::usersMutex;
+bool UserManager::dirty = false;
 
 GameUser UserManager::loadUser(const std::string& userId) {
+    static LatencyHistogram& latency = LatencyRegistry::get("users loadUser");
+    LatencyTimer timer(latency);
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
     auto it = usersCache.find(userId);
     if (it != usersCache.end()) {
         return it->second;
@@ -18,6 +24,7 @@ GameUser UserManager::loadUser(const std::string& userId) {
 }
 
 std::optional<GameUser> UserManager::loadFriend(const std::string& userId) {
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
     auto it = usersCache.find(userId);
     if (it != usersCache.end()) {
         return it->second;
@@ -28,6 +35,8 @@ std::optional<GameUser> UserManager::loadFriend(const std::string& userId) {
 
 std::string UserManager::getName(const std::string& userId)
 {
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
+
     auto it = usersCache.find(userId);
     if (it != usersCache.end())
     {
@@ -38,6 +47,8 @@ std::string UserManager::getName(const std::string& userId)
 }
 
 void UserManager::loadAllUsers() {
+    LatencyTimer timer("users loadAllUsers");
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
 
     std::ifstream inFile("../data/users.json");
 
@@ -70,14 +81,69 @@ void UserManager::loadAllUsers() {
 }
 
 void UserManager::saveUser(const GameUser& user) {
+    static LatencyHistogram& latency = LatencyRegistry::get("users saveUser");
+    LatencyTimer timer(latency);
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
+    auto it = usersCache.find(user.getId());
+    bool blockedBot = it != usersCache.end() && it->second.hasBlockedBot();
     usersCache[user.getId()] = user;
+    usersCache[user.getId()].setBlockedBot(blockedBot);
+    dirty = true;
+}
+
+bool UserManager::updateUser(const std::string& userId, const std::function<void(GameUser&)>& change)
+{
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
+    auto it = usersCache.find(userId);
+    if (it == usersCache.end())
+    {
+        return false;
+    }
+
+    change(it->second);
+    dirty = true;
+    return true;
+}
+
+bool UserManager::hasBlockedBot(const std::string& userId)
+{
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
+    auto it = usersCache.find(userId);
+    return it != usersCache.end() && it->second.hasBlockedBot();
+}
+
+void UserManager::setBlockedBot(const std::string& userId, bool blocked)
+{
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
+    auto it = usersCache.find(userId);
+    if (it != usersCache.end() && it->second.hasBlockedBot() != blocked)
+    {
+        it->second.setBlockedBot(blocked);
+        // Written right away: missing it after a restart means messaging users who blocked the bot
+        saveAllUsers();
+    }
 }
 
 void UserManager::saveAllUsers() {
+    LatencyTimer timer("users saveAllUsers");
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
     nlohmann::json j;
     for (const auto& pair : usersCache) {
         j[pair.first] = pair.second.toJson();
     }
     std::ofstream outFile("../data/users.json");
     outFile << j.dump(4);
+    dirty = false;
+}
+
+bool UserManager::saveIfDirty()
+{
+    std::lock_guard<std::recursive_mutex> lock(usersMutex);
+    if (!dirty)
+    {
+        return false;
+    }
+
+    saveAllUsers();
+    return true;
 }
@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+#include <istream>
+
+#include "../include/WebhookServer.hpp"
+#include "../include/Logger.hpp"
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+static const char* statusText(int status)
+{
+    switch (status)
+    {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    default: return "Internal Server Error";
+    }
+}
+
+static std::string lowercase(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+static std::string trim(const std::string& text)
+{
+    size_t start = text.find_first_not_of(" \t\r");
+    size_t end = text.find_last_not_of(" \t\r");
+    return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+}
+
+// Takes as long whatever the first mismatch, so the token can't be guessed by timing
+static bool secretMatches(const std::string& received, const std::string& expected)
+{
+    unsigned char difference = received.size() == expected.size() ? 0 : 1;
+
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        difference |= static_cast<unsigned char>(expected[i] ^ (i < received.size() ? received[i] : 0));
+    }
+
+    return difference == 0;
+}
+
+// One connection. Requests are read and answered one after another; a client may
+// pipeline several, they are simply picked up from the buffer in order.
+template <typename Stream>
+class WebhookSession : public std::enable_shared_from_this<WebhookSession<Stream>>
+{
+public:
+    template <typename... Args>
+    WebhookSession(std::shared_ptr<WebhookServer::State> state, Args&&... args)
+        : state(std::move(state)), stream(std::forward<Args>(args)...), timer(stream.get_executor()),
+          buffer(this->state->config.maxHeaderBytes)
+    {
+        this->state->connections++;
+        this->state->openConnections++;
+    }
+
+    ~WebhookSession()
+    {
+        state->openConnections--;
+    }
+
+    void start()
+    {
+        handshake(std::is_same<Stream, tcp::socket>());
+    }
+
+private:
+    void handshake(std::true_type)
+    {
+        readHeaders();
+    }
+
+    void handshake(std::false_type)
+    {
+        armTimer();
+        auto self = this->shared_from_this();
+        stream.async_handshake(asio::ssl::stream_base::server, [self](const boost::system::error_code& error) {
+            if (!error)
+            {
+                self->readHeaders();
+            }
+            else
+            {
+                self->timer.cancel();
+            }
+        });
+    }
+
+    tcp::socket& socket()
+    {
+        return static_cast<tcp::socket&>(stream.lowest_layer());
+    }
+
+    // Idle connections are closed so clients can't hold them forever
+    void armTimer()
+    {
+        timer.expires_after(std::chrono::seconds(state->config.idleTimeoutSeconds));
+        auto self = this->shared_from_this();
+        timer.async_wait([self](const boost::system::error_code& error) {
+            if (!error)
+            {
+                boost::system::error_code ignored;
+                self->socket().close(ignored);
+            }
+        });
+    }
+
+    void readHeaders()
+    {
+        armTimer();
+        auto self = this->shared_from_this();
+        asio::async_read_until(stream, buffer, "\r\n\r\n", [self](const boost::system::error_code& error, size_t headerBytes) {
+            if (!error)
+            {
+                self->parseHeaders(headerBytes);
+            }
+            else if (error == asio::error::not_found)
+            {
+                // The buffer filled up before the blank line ending the headers
+                self->keepAlive = false;
+                self->respond(431);
+            }
+            else
+            {
+                self->timer.cancel();
+            }
+        });
+    }
+
+    void parseHeaders(size_t headerBytes)
+    {
+        std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerBytes);
+        buffer.consume(headerBytes);
+
+        std::istringstream lines(headers);
+        std::string line;
+        std::getline(lines, line);
+
+        std::istringstream requestLine(line);
+        std::string version;
+        requestLine >> method >> target >> version;
+
+        contentLength = 0;
+        secretToken.clear();
+        keepAlive = version != "HTTP/1.0";
+
+        while (std::getline(lines, line) && line != "\r")
+        {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+
+            std::string name = lowercase(line.substr(0, colon));
+            std::string value = trim(line.substr(colon + 1));
+
+            if (name == "content-length")
+            {
+                contentLength = std::strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (name == "x-telegram-bot-api-secret-token")
+            {
+                secretToken = value;
+            }
+            else if (name == "connection")
+            {
+                std::string connection = lowercase(value);
+                keepAlive = connection == "keep-alive" || (keepAlive && connection != "close");
+            }
+        }
+
+        if (contentLength > state->config.maxBodyBytes)
+        {
+            keepAlive = false;
+            respond(413);
+            return;
+        }
+
+        // The body is read into its own string: the buffer is capped at maxHeaderBytes and
+        // only ever holds headers plus whatever the client sent along with them
+        size_t buffered = std::min(buffer.size(), contentLength);
+        body.assign(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + buffered);
+        buffer.consume(buffered);
+
+        if (buffered == contentLength)
+        {
+            handleBody();
+            return;
+        }
+
+        body.resize(contentLength);
+        auto self = this->shared_from_this();
+        asio::async_read(stream, asio::buffer(&body[buffered], contentLength - buffered),
+                         [self](const boost::system::error_code& error, size_t) {
+            if (!error)
+            {
+                self->handleBody();
+            }
+            else
+            {
+                self->timer.cancel();
+            }
+        });
+    }
+
+    void handleBody()
+    {
+        state->requests++;
+
+        if (method != "POST")
+        {
+            respond(405);
+            return;
+        }
+        if (target != state->config.path)
+        {
+            respond(404);
+            return;
+        }
+        if (!secretMatches(secretToken, state->config.secretToken))
+        {
+            logger.log(LogLevel::WARNING, "Webhook request with a wrong secret token from " + remoteAddress());
+            respond(401);
+            return;
+        }
+
+        try
+        {
+            state->onUpdate(body);
+        }
+        catch (std::exception& e)
+        {
+            logger.log(LogLevel::ERROR, std::string("Rejected webhook update: ") + e.what());
+            respond(400);
+            return;
+        }
+
+        respond(200);
+    }
+
+    std::string remoteAddress()
+    {
+        boost::system::error_code error;
+        tcp::endpoint endpoint = socket().remote_endpoint(error);
+        return error ? "unknown" : endpoint.address().to_string();
+    }
+
+    void respond(int status)
+    {
+        if (status != 200)
+        {
+            state->rejected++;
+        }
+
+        response = "HTTP/1.1 " + std::to_string(status) + " " + statusText(status) + "\r\n" +
+                   "Content-Length: 0\r\n" +
+                   "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n\r\n";
+
+        auto self = this->shared_from_this();
+        asio::async_write(stream, asio::buffer(response), [self](const boost::system::error_code& error, size_t) {
+            if (error)
+            {
+                self->timer.cancel();
+                return;
+            }
+
+            if (self->keepAlive)
+            {
+                self->readHeaders();
+            }
+            else
+            {
+                self->timer.cancel();
+                boost::system::error_code ignored;
+                self->socket().shutdown(tcp::socket::shutdown_both, ignored);
+            }
+        });
+    }
+
+    std::shared_ptr<WebhookServer::State> state;
+    Stream stream;
+    asio::steady_timer timer;
+    asio::streambuf buffer;
+
+    std::string method;
+    std::string target;
+    std::string secretToken;
+    std::string body;
+    size_t contentLength = 0;
+    bool keepAlive = true;
+    std::string response;
+};
+
+WebhookServer::WebhookServer(const WebhookConfig& config, UpdateCallback onUpdate)
+    : state(std::make_shared<State>()), acceptor(io)
+{
+    if (config.secretToken.empty())
+    {
+        throw std::invalid_argument("Webhook mode needs a secret token");
+    }
+
+    state->config = config;
+    state->onUpdate = std::move(onUpdate);
+
+    if (!config.certificateFile.empty() && !config.privateKeyFile.empty())
+    {
+        tls = std::make_unique<asio::ssl::context>(asio::ssl::context::tls_server);
+        tls->set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 | asio::ssl::context::no_sslv3);
+        tls->use_certificate_chain_file(config.certificateFile);
+        tls->use_private_key_file(config.privateKeyFile, asio::ssl::context::pem);
+    }
+}
+
+WebhookServer::~WebhookServer()
+{
+    stop();
+}
+
+void WebhookServer::start()
+{
+    tcp::endpoint endpoint(asio::ip::make_address(state->config.address), state->config.port);
+
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(asio::socket_base::reuse_address(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+
+    accept();
+
+    for (size_t i = 0; i < std::max<size_t>(1, state->config.threads); ++i)
+    {
+        threads.emplace_back([this]() { io.run(); });
+    }
+
+    logger.log(LogLevel::INFO, "Webhook server listening on " + state->config.address + ":" + std::to_string(state->config.port) +
+                               state->config.path + (tls ? " (TLS)" : ""));
+}
+
+void WebhookServer::stop()
+{
+    io.stop();
+
+    for (auto& thread : threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    threads.clear();
+}
+
+WebhookMetrics WebhookServer::getMetrics() const
+{
+    return {state->connections, state->openConnections, state->requests, state->rejected};
+}
+
+void WebhookServer::accept()
+{
+    acceptor.async_accept(asio::make_strand(io), [this](const boost::system::error_code& error, tcp::socket socket) {
+        if (!error)
+        {
+            socket.set_option(tcp::no_delay(true));
+
+            if (tls)
+            {
+                std::make_shared<WebhookSession<asio::ssl::stream<tcp::socket>>>(state, std::move(socket), *tls)->start();
+            }
+            else
+            {
+                std::make_shared<WebhookSession<tcp::socket>>(state, std::move(socket))->start();
+            }
+        }
+
+        if (acceptor.is_open())
+        {
+            accept();
+        }
+    });
+}
@@ -1,34 +1,61 @@
+#include <algorithm>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <string>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <iomanip>
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <mutex>
 #include <filesystem>
+#include <optional>
+#include <random>
+#include <unordered_set>
 
-#include <cairo/cairo.h>
 #include <tgbot/tgbot.h>
 #include "../include/UserManager.hpp"
 #include "../include/GameUser.hpp"
 #include "../include/Logger.hpp"
+#include "../include/StatsChart.hpp"
+#include "../include/ChartCache.hpp"
+#include "../include/FileIdCache.hpp"
+#include "../include/ChartRenderPool.hpp"
+#include "../include/ChartEncoder.hpp"
+#include "../include/UpdateDispatcher.hpp"
+#include "../include/CallbackRouter.hpp"
+#include "../include/CallbackCodec.hpp"
+#include "../include/WebhookServer.hpp"
+#include "../include/ApiExecutor.hpp"
+#include "../include/CallbackDeduplicator.hpp"
+#include "../include/ConversationStore.hpp"
+#include "../include/LatencyHistogram.hpp"
+#include "../include/TimedHttpClient.hpp"
 
 using namespace TgBot;
 
-enum class UserState {
-    NONE,
-    WAITING_FOR_NEW_NAME,
-    WAITING_FOR_FRIEND_ID
-};
-
 std::vector<std::shared_ptr<TgBot::BotCommand>> commands;
-std::unordered_map<int64_t, UserState> userStates;
 Logger logger("../data/logs/bot", LogLevel::DEBUG);
 std::atomic<bool> updaterRunning(true);
+std::unique_ptr<ChartRenderPool> chartRenderPool;
+std::unique_ptr<UpdateDispatcher> updateDispatcher;
+std::unique_ptr<ApiExecutor> apiExecutor;
+std::atomic<bool> botRunning(true);
+CallbackRouter callbackRouter;
+// Double taps on a button arrive well within this window
+CallbackDeduplicator callbackDeduplicator(std::chrono::milliseconds(1500));
+
+// Multi-step flows (waiting for a new name, a friend id) per chat
+std::unique_ptr<ConversationStore> conversations;
+const std::string conversationsPath = "../data/conversations.json";
+
+// Chats allowed to use /stats, from TELEGACHA_ADMIN_IDS
+std::unordered_set<int64_t> adminIds;
 
 void periodicUsersUpdate()
 {
@@ -43,14 +70,66 @@ void periodicUsersUpdate()
         auto updateStartTime = std::chrono::steady_clock::now();
         
         logger.log(LogLevel::BACKGROUND, "Starting user update #" + std::to_string(updateCount));
-        UserManager::loadAllUsers();
+        // Save only: usersCache is the newer copy while the bot runs, and reloading it from
+        // disk would undo changes made since the last save
+        bool saved = UserManager::saveIfDirty();
         
         auto updateEndTime = std::chrono::steady_clock::now();
         auto updateDuration = std::chrono::duration_cast<std::chrono::milliseconds>(updateEndTime - updateStartTime);
         
-        logger.log(LogLevel::BACKGROUND, "User update #" + std::to_string(updateCount) + " completed in " + std::to_string(updateDuration.count()) + "ms");
+        logger.log(LogLevel::BACKGROUND, "User update #" + std::to_string(updateCount) + (saved ? " saved users" : " had nothing to save") + " in " + std::to_string(updateDuration.count()) + "ms");
+
+        if (chartRenderPool)
+        {
+            ChartRenderMetrics metrics = chartRenderPool->getMetrics();
+            logger.log(LogLevel::BACKGROUND, "Chart pool: queue " + std::to_string(metrics.queueDepth) + "/" + std::to_string(metrics.queueCapacity) +
+                                             ", rendered " + std::to_string(metrics.rendered) + ", rejected " + std::to_string(metrics.rejected) +
+                                             ", avg render " + std::to_string(metrics.avgRenderMs) + "ms, max render " + std::to_string(metrics.maxRenderMs) +
+                                             "ms, avg queue wait " + std::to_string(metrics.avgQueueWaitMs) + "ms");
+        }
+
+        logger.log(LogLevel::BACKGROUND, "Repeated callbacks ignored: " + std::to_string(callbackDeduplicator.getDuplicates()));
 
-        std::this_thread::sleep_for(std::chrono::seconds(60));
+        if (updateDispatcher)
+        {
+            std::string shardDepths;
+            size_t handled = 0;
+            for (const UpdateShardMetrics& shard : updateDispatcher->getMetrics())
+            {
+                shardDepths += (shardDepths.empty() ? "" : " ") + std::to_string(shard.queueDepth) + "/" + std::to_string(shard.maxQueueDepth);
+                handled += shard.handled;
+            }
+            logger.log(LogLevel::BACKGROUND, "Update shards (depth/max): " + shardDepths + ", handled " + std::to_string(handled));
+        }
+
+        if (apiExecutor)
+        {
+            ApiExecutorMetrics metrics = apiExecutor->getMetrics();
+            logger.log(LogLevel::BACKGROUND, "Bot API calls: queue " + std::to_string(metrics.queueDepth) + "/" + std::to_string(metrics.queueCapacity) +
+                                             " (" + std::to_string(metrics.interactiveDepth) + " interactive, " + std::to_string(metrics.notificationDepth) + " notifications)" +
+                                             ", throttled chats " + std::to_string(metrics.throttledChats) + ", sent " + std::to_string(metrics.calls) +
+                                             ", failed " + std::to_string(metrics.failed) + ", rate limited " + std::to_string(metrics.rateLimited) +
+                                             ", avg call " + std::to_string(metrics.avgCallMs) + "ms, avg queue wait " + std::to_string(metrics.avgQueueWaitMs) + "ms");
+        }
+
+        conversations->expire();
+        conversations->save(conversationsPath);
+
+        FileIdCache::saveIfDirty();
+
+        ConversationMetrics conversationMetrics = conversations->getMetrics();
+        logger.log(LogLevel::BACKGROUND, "Conversations: " + std::to_string(conversationMetrics.entries) + " open, expired " + std::to_string(conversationMetrics.expired) +
+                                         ", evicted " + std::to_string(conversationMetrics.evicted));
+
+        ChartPoolMetrics canvasMetrics = getStatsChartPoolMetrics();
+        logger.log(LogLevel::BACKGROUND, "Chart canvases: acquired " + std::to_string(canvasMetrics.acquired) + ", reused " + std::to_string(canvasMetrics.reused) +
+                                         ", created " + std::to_string(canvasMetrics.created) + ", discarded " + std::to_string(canvasMetrics.discarded) +
+                                         ", idle " + std::to_string(canvasMetrics.idle) + "/" + std::to_string(canvasMetrics.limit));
+
+        for (int i = 0; i < 60 && updaterRunning; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
         
         auto currentTime = std::chrono::steady_clock::now();
         auto totalRuntime = std::chrono::duration_cast<std::chrono::minutes>(currentTime - startTime);
@@ -107,224 +186,142 @@ void setBotCommands()
     commands.push_back(cmd5);
 }
 
-double degreesToRadians(double degrees) { return degrees * M_PI / 180.0; }
-
-void drawStatsChart(const std::vector<std::pair<std::string, double>>& stats, const std::string& filename)
+void uploadStatsChart(const Bot& bot, int64_t chatId, const std::string& chartKey, const std::string& png,
+                      const std::string& caption, GenericReply::Ptr keyboard, ReplyParameters::Ptr replyParameters = nullptr)
 {
-    std::filesystem::path filePath(filename);
+    InputFile::Ptr photo = std::make_shared<InputFile>();
+    photo->data = png;
+    ChartFormat format = getChartEncoderSettings().format;
+    photo->mimeType = chartMimeType(format);
+    photo->fileName = "stats." + chartFileExtension(format);
 
-    if (!std::filesystem::exists(filePath.parent_path()))
+    Message::Ptr sent = bot.getApi().sendPhoto(chatId, photo, caption, replyParameters, keyboard);
+
+    if (sent != nullptr && !sent->photo.empty())
     {
-        logger.log(LogLevel::INFO, "Could not find path \"" + filename + "\". Creating one...");
-        std::filesystem::create_directories(filePath.parent_path());
+        FileIdCache::put(chartKey, sent->photo.back()->fileId);
     }
+}
 
-    std::vector<std::tuple<double, double, double>> colors = {
-        {1.0, 0.0, 0.0}, // Red for Attack
-        {0.0, 1.0, 0.0}, // Green for Defense
-        {0.0, 0.0, 1.0}, // Blue for Speed
-        {1.0, 1.0, 0.0}, // Yellow for Luck
-        {1.0, 0.0, 1.0}  // Magenta for Magic
-    };
-
-    int width = 500;
-    int height = 500;
-    int numStats = stats.size();
-    double maxRadius = 100.0;
-    double graphCenterX = width / 3.1;
-    double graphCenterY = height / 2.5;
-    double centerX = width / 2;
-    double centerY = height / 2;
-    double angleStep = 2 * M_PI / numStats; // Angle between each stat
-
-    // Create a new surface and context
-    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
-    cairo_t* cr = cairo_create(surface);
-
-    // Create font face and size
-    cairo_select_font_face(cr, "Arial", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-    double fontSize = 20.0;
-    cairo_set_font_size(cr, fontSize);
-
-    // Set the background color to white
-    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-
-    cairo_pattern_t* bgGradient = cairo_pattern_create_radial(
-        width / 2, height / 2, 0,  // Inner circle (start of gradient)
-        width / 2, height / 2, 500  // Outer circle (end of gradient)
-    );
-
-    cairo_pattern_add_color_stop_rgba(bgGradient, 0.0, 1.0, 1.0, 1.0, 1.0);  // Full color at center
-    cairo_pattern_add_color_stop_rgba(bgGradient, 1.0, 0.0, 0.0, 0.0, 1.0);  // Darker mid-point
-
-    cairo_set_source(cr, bgGradient);
-
-    cairo_paint(cr);
-
-    cairo_pattern_destroy(bgGradient);
-
-    for (int i = 0; i < numStats; ++i) {
-        double angle = -M_PI / 2 + i * angleStep;
-        double labelRadius = maxRadius + 20; // Place labels slightly outside the chart
-        double x = graphCenterX + labelRadius * cos(angle);
-        double y = graphCenterY + labelRadius * sin(angle);
-
-        // Get the label text
-        const std::string& label = stats[i].first;
-
-        // Calculate text extents
-        cairo_text_extents_t extents;
-        cairo_text_extents(cr, label.c_str(), &extents);
+void sendChart(const Bot& bot, int64_t chatId, const std::string& chartKey, ChartRenderPool::Render render,
+               const std::string& caption, GenericReply::Ptr keyboard, ReplyParameters::Ptr replyParameters = nullptr)
+{
+    // Runs on the chat's API sender, after anything already queued for the chat
+    apiExecutor->post(chatId, [&bot, chatId, chartKey, render, caption, keyboard, replyParameters]() {
+        // A chart Telegram already has is sent by file_id instead of being uploaded again
+        std::optional<std::string> fileId = FileIdCache::get(chartKey);
+        if (fileId.has_value())
+        {
+            try
+            {
+                bot.getApi().sendPhoto(chatId, fileId.value(), caption, replyParameters, keyboard);
+                return;
+            }
+            catch (TgException& e)
+            {
+                if (e.errorCode != TgException::ErrorCode::BadRequest)
+                {
+                    throw;
+                }
 
-        // Adjust position of the label
-        double textX, textY;
-        if (cos(angle) < 0) {
-            textX = x - extents.width;
-        } else {
-            textX = x;
-        }
-        if (sin(angle) < 0) {
-            textY = y;
-        } else {
-            textY = y + extents.height;
+                logger.log(LogLevel::WARNING, "Cached file_id for chart " + chartKey + " was rejected (" + e.what() + "). Uploading again.");
+                FileIdCache::remove(chartKey);
+            }
         }
 
-        // Set color to black for the text
-        cairo_set_source_rgb(cr, 0, 0, 0);
+        std::shared_ptr<const std::string> chart = ChartCache::get(chartKey);
 
-        // Draw the text
-        cairo_move_to(cr, textX, textY);
-        cairo_show_text(cr, label.c_str());
-    }
+        if (chart)
+        {
+            uploadStatsChart(bot, chatId, chartKey, *chart, caption, keyboard, replyParameters);
+            return;
+        }
 
-    // Draw the radar chart area with stats
-    std::vector<std::pair<double, double>> points;
-    cairo_set_line_width(cr, 2.0);
-    for (int i = 0; i < numStats; ++i) {
-        double angle = -M_PI / 2 + i * angleStep;
-        double value = stats[i].second;
-        double x = graphCenterX + (value / 100.0) * maxRadius * cos(angle);
-        double y = graphCenterY + (value / 100.0) * maxRadius * sin(angle);
-
-        // Get colors for the current stat
-        double r = std::get<0>(colors[i]);
-        double g = std::get<1>(colors[i]);
-        double b = std::get<2>(colors[i]);
-        
-        // Create a radial gradient
-        cairo_pattern_t *gradient = cairo_pattern_create_radial(
-            graphCenterX, graphCenterY, 0,  // Inner circle (start of gradient)
-            graphCenterX, graphCenterY, maxRadius  // Outer circle (end of gradient)
-        );
-
-        // Add color stops to the gradient
-        cairo_pattern_add_color_stop_rgba(gradient, 0, r, g, b, 1.0);  // Full color at center
-        cairo_pattern_add_color_stop_rgba(gradient, 0.7, r * 0.7, g * 0.7, b * 0.7, 1.0);  // Darker mid-point
-        cairo_pattern_add_color_stop_rgba(gradient, 1, r * 0.4, g * 0.4, b * 0.4, 1.0);  // Even darker at edges
-
-        // Set the gradient as the source
-        cairo_set_source(cr, gradient);
-
-        // Draw a triangle for the current stat
-        cairo_move_to(cr, graphCenterX, graphCenterY);
-        cairo_line_to(cr, x, y);
-        
-        // Calculate the next point
-        int nextIndex = (i + 1) % numStats;
-        double nextAngle = -M_PI / 2 + nextIndex * angleStep;
-        double nextValue = stats[nextIndex].second;
-        double nextX = graphCenterX + (nextValue / 100.0) * maxRadius * cos(nextAngle);
-        double nextY = graphCenterY + (nextValue / 100.0) * maxRadius * sin(nextAngle);
-        
-        cairo_line_to(cr, nextX, nextY);
-        cairo_close_path(cr);
-        cairo_fill(cr);
+        // Render on the chart pool and queue the upload once the chart is ready
+        bool queued = chartRenderPool->submit(chartKey, render, [&bot, chatId, chartKey, caption, keyboard, replyParameters](std::shared_ptr<const std::string> png) {
+            apiExecutor->post(chatId, [&bot, chatId, chartKey, png, caption, keyboard, replyParameters]() {
+                uploadStatsChart(bot, chatId, chartKey, *png, caption, keyboard, replyParameters);
+            });
+        });
 
-        // Clean up the gradient pattern
-        cairo_pattern_destroy(gradient);
+        if (!queued)
+        {
+            logger.log(LogLevel::WARNING, "Chart render queue is full. Rendering chart " + chartKey + " inline.");
+            chart = ChartCache::put(chartKey, render());
+            uploadStatsChart(bot, chatId, chartKey, *chart, caption, keyboard, replyParameters);
+        }
+    });
+}
 
-        points.emplace_back(x, y);
-    }
+void sendStatsChart(const Bot& bot, int64_t chatId, const std::vector<std::pair<std::string, double>>& stats,
+                    const std::string& caption, GenericReply::Ptr keyboard, ReplyParameters::Ptr replyParameters = nullptr)
+{
+    // Users with identical stats share one rendered chart
+    sendChart(bot, chatId, statsChartKey(stats), [stats]() -> const std::string& {
+        return drawStatsChart(stats);
+    }, caption, keyboard, replyParameters);
+}
 
-    // Draw the grid lines and background
-    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0); // Black color
-    cairo_set_line_width(cr, 1.0);
-    for (int i = 0; i < numStats; ++i) {
-        double angle = -M_PI / 2 + i * angleStep;
-        double x = graphCenterX + maxRadius * cos(angle);
-        double y = graphCenterY + maxRadius * sin(angle);
-
-        cairo_move_to(cr, graphCenterX, graphCenterY);
-        cairo_line_to(cr, x, y);
-        cairo_stroke(cr);
-    }
+void sendComparisonChart(const Bot& bot, int64_t chatId, const std::vector<std::pair<std::string, double>>& stats,
+                         const std::vector<std::pair<std::string, double>>& friendStats, const std::string& caption, GenericReply::Ptr keyboard)
+{
+    // Keyed by both stat vectors, so any two users with the same pair of stats share it
+    sendChart(bot, chatId, comparisonChartKey(stats, friendStats), [stats, friendStats]() -> const std::string& {
+        return drawComparisonChart(stats, friendStats);
+    }, caption, keyboard);
+}
 
-    // Draw concentric polygons (grid)
-    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0); // Black color
-    cairo_set_line_width(cr, 1.0);
-    for (int i = 1; i <= 4; ++i) {
-        double radius = maxRadius * i / 4;
-        double angleStep = 2 * M_PI / numStats; // Calculate the angle between vertices
-        double startAngle = -M_PI / 2; // Starting angle for the first vertex
-    
-        cairo_move_to(cr, graphCenterX + radius * cos(startAngle), graphCenterY + radius * sin(startAngle));
-        for (int j = 1; j < numStats; ++j) {
-            double angle = startAngle + j * angleStep;
-            cairo_line_to(cr, graphCenterX + radius * cos(angle), graphCenterY + radius * sin(angle));
+// Turns `editable` into the given text menu, or sends a new message when there is nothing
+// to edit or the edit is refused (too old, deleted). A photo can't become a text message,
+// so it is replaced. Must run on the chat's API sender; returns the message showing the menu.
+Message::Ptr editOrSendMenu(const Bot& bot, int64_t chatId, const std::string& text, InlineKeyboardMarkup::Ptr keyboard,
+                            Message::Ptr editable, const std::string& parseMode = "")
+{
+    if (editable != nullptr && editable->photo.empty())
+    {
+        try
+        {
+            return bot.getApi().editMessageText(text, chatId, editable->messageId, "", parseMode, nullptr, keyboard);
         }
-        cairo_close_path(cr);
-        cairo_stroke(cr);
-    }
+        catch (TgException& e)
+        {
+            if (e.errorCode != TgException::ErrorCode::BadRequest)
+            {
+                throw;
+            }
+            // Pressing the button of the menu already shown
+            if (std::string(e.what()).find("message is not modified") != std::string::npos)
+            {
+                return editable;
+            }
 
-    // Draw the lines connecting the stats
-    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0); // Black color
-    cairo_set_line_width(cr, 2.0);
-    cairo_move_to(cr, points[0].first, points[0].second);
-    for (int i = 1; i < numStats; ++i) {
-        cairo_line_to(cr, points[i].first, points[i].second);
+            logger.log(LogLevel::WARNING, "Can't edit message " + std::to_string(editable->messageId) + " in " + std::to_string(chatId) + " (" + e.what() + "). Sending a new one.");
+        }
     }
-    cairo_close_path(cr);
-    cairo_stroke(cr);
-
-    double statsTextNameX = centerX + (centerX / 2.7);
-    double statsTextNameY = centerY / 1.8;
-
-    double statsTextValueX = width - width / 10;
-    double statsTextValueY = centerY / 1.8;
-
-    cairo_set_font_size(cr, fontSize * 2);
-
-    cairo_move_to(cr, centerX - (centerX / 4), 40);
-    cairo_show_text(cr, "STATS");
-
-    cairo_set_font_size(cr, fontSize);
-    
-    for (const auto& stat : stats)
+    else if (editable != nullptr)
     {
-        std::ostringstream oss;
-        oss << std::fixed << std::setprecision(1) << stat.second;
-        std::string name = stat.first + ":";
-        std::string value = oss.str();
-
-        cairo_move_to(cr, statsTextNameX, statsTextNameY);
-        cairo_show_text(cr, name.c_str());
-
-        cairo_move_to(cr, statsTextValueX, statsTextValueY);
-        cairo_show_text(cr, value.c_str());
-        
-        statsTextNameY += 30;
-        statsTextValueY += 30;
+        try
+        {
+            bot.getApi().deleteMessage(chatId, editable->messageId);
+        }
+        catch (TgException& e)
+        {
+            logger.log(LogLevel::WARNING, "Can't delete message " + std::to_string(editable->messageId) + " in " + std::to_string(chatId) + " (" + e.what() + ").");
+        }
     }
 
-    // Save the image to a file
-    cairo_surface_write_to_png(surface, filename.c_str());
+    return bot.getApi().sendMessage(chatId, text, nullptr, 0, keyboard, parseMode);
+}
 
-    // Clean up
-    cairo_destroy(cr);
-    cairo_surface_destroy(surface);
+void showMenu(const Bot& bot, int64_t chatId, const std::string& text, InlineKeyboardMarkup::Ptr keyboard,
+              Message::Ptr editable = nullptr, const std::string& parseMode = "")
+{
+    apiExecutor->post(chatId, [&bot, chatId, text, keyboard, editable, parseMode]() {
+        editOrSendMenu(bot, chatId, text, keyboard, editable, parseMode);
+    });
 }
 
-void handleProfileCommand(const Bot& bot, Message::Ptr message)
+void handleProfileCommand(const Bot& bot, Message::Ptr message, Message::Ptr editable = nullptr)
 {
     std::string userId = std::to_string(message->chat->id);
 
@@ -332,16 +329,13 @@ void handleProfileCommand(const Bot& bot, Message::Ptr message)
 
     std::vector<std::pair<std::string, double>> userStats = user.getStats();
 
-    std::string filename = "../data/img/" + userId + "/stats.png";
-    drawStatsChart(userStats, filename);
-
     InlineKeyboardButton::Ptr changeNameButton(new InlineKeyboardButton);
     changeNameButton->text = "Change Name";
-    changeNameButton->callbackData = "change_name_" + userId;
+    changeNameButton->callbackData = CallbackCodec::encode(CallbackAction::CHANGE_NAME, {message->chat->id});
 
     InlineKeyboardButton::Ptr menuButton(new InlineKeyboardButton);
     menuButton->text = "Back to Main Menu";
-    menuButton->callbackData = "back_to_menu_" + userId;
+    menuButton->callbackData = CallbackCodec::encode(CallbackAction::BACK_TO_MENU, {message->chat->id});
 
     InlineKeyboardMarkup::Ptr keyboard(new InlineKeyboardMarkup);
     keyboard->inlineKeyboard.push_back({changeNameButton}); 
@@ -349,6 +343,11 @@ void handleProfileCommand(const Bot& bot, Message::Ptr message)
 
     std::string profileMessage = "Name: " + user.getGameName() + "\n" +
                                 "Registration Date: " + formatDate(0, user.getRegDate()) + "\n";
+
+    std::ostringstream power;
+    power << std::fixed << std::setprecision(1) << user.getPowerScore();
+    profileMessage += "Level: " + std::to_string(user.getLevel()) + "\n" +
+                      "Power: " + power.str() + "\n";
     
     profileMessage += "\nSTATS:\n";
 
@@ -356,14 +355,83 @@ void handleProfileCommand(const Bot& bot, Message::Ptr message)
     {
         std::ostringstream oss;
         oss << std::fixed << std::setprecision(1) << i.second;
-        profileMessage += i.first + ": " + oss.str() + "\n";
+        profileMessage += i.first + ": " + oss.str() + " (" + user.getStatRank(i.first) + ")\n";
+    }
+
+    int64_t chatId = message->chat->id;
+    std::optional<std::string> fileId = FileIdCache::get(statsChartKey(userStats));
+
+    // A chart Telegram already has replaces a photo menu in place, or goes out with the
+    // text in a single sendPhoto when there is nothing to edit
+    if (fileId.has_value() && (editable == nullptr || !editable->photo.empty()))
+    {
+        if (editable == nullptr)
+        {
+            sendStatsChart(bot, chatId, userStats, profileMessage, keyboard);
+            return;
+        }
+
+        apiExecutor->post(chatId, [&bot, chatId, profileMessage, keyboard, userStats, editable, fileId]() {
+            InputMediaPhoto::Ptr media = std::make_shared<InputMediaPhoto>();
+            media->type = "photo";
+            media->media = fileId.value();
+            media->caption = profileMessage;
+
+            try
+            {
+                bot.getApi().editMessageMedia(media, chatId, editable->messageId, "", keyboard);
+                return;
+            }
+            catch (TgException& e)
+            {
+                if (e.errorCode != TgException::ErrorCode::BadRequest)
+                {
+                    throw;
+                }
+                // Pressing the button of the profile already shown
+                if (std::string(e.what()).find("message is not modified") != std::string::npos)
+                {
+                    return;
+                }
+
+                logger.log(LogLevel::WARNING, "Can't edit message " + std::to_string(editable->messageId) + " in " + std::to_string(chatId) + " (" + e.what() + "). Sending a new one.");
+            }
+
+            // Don't leave the old menu next to the new one
+            try
+            {
+                bot.getApi().deleteMessage(chatId, editable->messageId);
+            }
+            catch (TgException& e)
+            {
+                logger.log(LogLevel::WARNING, "Can't delete message " + std::to_string(editable->messageId) + " in " + std::to_string(chatId) + " (" + e.what() + ").");
+            }
+
+            sendStatsChart(bot, chatId, userStats, profileMessage, keyboard);
+        });
+        return;
     }
 
-    bot.getApi().sendPhoto(message->chat->id, InputFile::fromFile(filename, "image/png"), profileMessage, 0, keyboard);
+    // Otherwise the text and keyboard go out right away (replacing the menu pressed) and
+    // the chart follows as a reply once it has been rendered and uploaded. Telegram can't
+    // turn a text message into a photo with editMessageMedia, so the chart can't be
+    // attached to the text itself.
+    apiExecutor->post(chatId, [&bot, chatId, profileMessage, keyboard, userStats, editable]() {
+        Message::Ptr sent = editOrSendMenu(bot, chatId, profileMessage, keyboard, editable);
+
+        ReplyParameters::Ptr replyParameters;
+        if (sent != nullptr)
+        {
+            replyParameters = std::make_shared<ReplyParameters>();
+            replyParameters->messageId = sent->messageId;
+            replyParameters->allowSendingWithoutReply = true;
+        }
 
+        sendStatsChart(bot, chatId, userStats, "", nullptr, replyParameters);
+    });
 }
 
-void handleStartCommand(const Bot& bot, Message::Ptr message)
+void handleStartCommand(const Bot& bot, Message::Ptr message, Message::Ptr editable = nullptr)
 {
     std::string userId = std::to_string(message->chat->id);
 
@@ -372,25 +440,25 @@ void handleStartCommand(const Bot& bot, Message::Ptr message)
         if (message->chat->username != user.getUsername())
         {
             logger.log(LogLevel::INFO, userId + " changed username (" + user.getUsername() + " -> " + message->chat->username + ")");
-            user.setUsername(message->chat->username);
-
-            UserManager::saveUser(user);
+            UserManager::updateUser(userId, [&](GameUser& stored) {
+                stored.setUsername(message->chat->username);
+            });
 
             UserManager::saveAllUsers();
         }
 
         InlineKeyboardButton::Ptr profileButton(new InlineKeyboardButton);
         profileButton->text = "Profile";
-        profileButton->callbackData = "profile_" + userId;
+        profileButton->callbackData = CallbackCodec::encode(CallbackAction::PROFILE, {message->chat->id});
 
         InlineKeyboardMarkup::Ptr keyboard(new InlineKeyboardMarkup);
         keyboard->inlineKeyboard.push_back({profileButton}); 
 
-        bot.getApi().sendMessage(message->chat->id, "MAIN MENU\n\nWelcome to TeleGacha, " + user.getGameName() + "!\n" +
-                                "Please choose an option.", nullptr, 0, keyboard);
+        showMenu(bot, message->chat->id, "MAIN MENU\n\nWelcome to TeleGacha, " + user.getGameName() + "!\n" +
+                                         "Please choose an option.", keyboard, editable);
 }
 
-void handleFriendsCommand(const Bot& bot, Message::Ptr message)
+void handleFriendsCommand(const Bot& bot, Message::Ptr message, Message::Ptr editable = nullptr)
 {
     std::string userId = std::to_string(message->chat->id);
 
@@ -400,11 +468,11 @@ void handleFriendsCommand(const Bot& bot, Message::Ptr message)
 
     InlineKeyboardButton::Ptr sendRequestBtn(new InlineKeyboardButton);
     sendRequestBtn->text = "Send Friend Request";
-    sendRequestBtn->callbackData = "send_friend_request_" + userId;
+    sendRequestBtn->callbackData = CallbackCodec::encode(CallbackAction::SEND_FRIEND_REQUEST, {message->chat->id});
 
     InlineKeyboardButton::Ptr viewRequestsBtn(new InlineKeyboardButton);
     viewRequestsBtn->text = "View Friend Requests";
-    viewRequestsBtn->callbackData = "view_friend_request_" + userId;
+    viewRequestsBtn->callbackData = CallbackCodec::encode(CallbackAction::VIEW_FRIEND_REQUESTS, {message->chat->id});
 
     InlineKeyboardMarkup::Ptr keyboard(new InlineKeyboardMarkup);
     keyboard->inlineKeyboard.push_back({sendRequestBtn}); 
@@ -415,6 +483,11 @@ void handleFriendsCommand(const Bot& bot, Message::Ptr message)
     for (const auto& i : friends)
     {
         text += UserManager::getName(i) + " (" + i + ")\n";
+
+        InlineKeyboardButton::Ptr compareBtn(new InlineKeyboardButton);
+        compareBtn->text = "Compare with " + UserManager::getName(i);
+        compareBtn->callbackData = CallbackCodec::encode(CallbackAction::COMPARE, {message->chat->id, std::stoll(i)});
+        keyboard->inlineKeyboard.push_back({compareBtn});
     }
 
     text += "\nYou have " + std::to_string(friends.size()) + (friends.size() > 1 ? " friends.\n\n" : " friend.\n\n");
@@ -424,10 +497,135 @@ void handleFriendsCommand(const Bot& bot, Message::Ptr message)
         text += "\n🆕 You have " + std::to_string(user.getIncomingFriendRequests().size()) + " pending friend" + (user.getIncomingFriendRequests().size() > 1 ? "requests" : "request") +  " incoming.\n";
     }
 
-    bot.getApi().sendMessage(message->chat->id, text, nullptr, 0, keyboard);
+    showMenu(bot, message->chat->id, text, keyboard, editable);
+}
+
+// Notifies another user without checking blockedByUser first: the send is simply
+// attempted and a 403 marks the user as having blocked the bot. The bot's HttpClient
+// doesn't retry (see TimedHttpClient), so each attempt is exactly one sendMessage call,
+// and once the flag is set later notifications to that user make none.
+void notifyUser(const Bot& bot, const std::string& userId, const std::string& text, int64_t requesterChatId)
+{
+    auto reportBlocked = [&bot, requesterChatId]() {
+        apiExecutor->post(requesterChatId, [&bot, requesterChatId]() {
+            bot.getApi().sendMessage(requesterChatId, "The requested user has blocked the bot. Kindly ask them to unlock the bot to accept the friend request.");
+        });
+    };
+
+    if (UserManager::hasBlockedBot(userId))
+    {
+        reportBlocked();
+        return;
+    }
+
+    int64_t chatId = std::stoll(userId);
+    apiExecutor->post(chatId, [&bot, chatId, userId, text, reportBlocked]() {
+        try
+        {
+            bot.getApi().sendMessage(chatId, text);
+        }
+        catch (TgException& e)
+        {
+            if (e.errorCode != TgException::ErrorCode::Forbidden)
+            {
+                throw;
+            }
+
+            logger.log(LogLevel::INFO, userId + " has blocked the bot.");
+            UserManager::setBlockedBot(userId, true);
+            reportBlocked();
+        }
+    }, ApiPriority::NOTIFICATION);
 }
 
-void handleRequestsCommand(const Bot& bot, Message::Ptr message)
+void handleCompareCommand(const Bot& bot, const std::string& userId, const std::string& friendId)
+{
+    GameUser user = UserManager::loadUser(userId);
+
+    std::vector<std::string> friends = user.getFriends();
+
+    if (std::find(friends.begin(), friends.end(), friendId) == friends.end())
+    {
+        logger.log(LogLevel::WARNING, userId + " tried to compare stats with " + friendId + ", who is not a friend.");
+        apiExecutor->post(std::stol(userId), [=, &bot]() {
+            bot.getApi().sendMessage(std::stol(userId), "You can only compare stats with your friends.");
+        });
+        return;
+    }
+
+    GameUser friendUser = UserManager::loadUser(friendId);
+
+    std::vector<std::pair<std::string, double>> userStats = user.getStats();
+    std::vector<std::pair<std::string, double>> friendStats = friendUser.getStats();
+
+    std::string text = user.getGameName() + " vs " + friendUser.getGameName() + " (blue)\n\n";
+
+    for (const auto& stat : userStats)
+    {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1) << stat.second << " / ";
+
+        auto it = std::find_if(friendStats.begin(), friendStats.end(), [&stat](const std::pair<std::string, double>& other) {
+            return other.first == stat.first;
+        });
+        oss << (it != friendStats.end() ? it->second : 0.0);
+
+        text += stat.first + ": " + oss.str() + "\n";
+    }
+
+    InlineKeyboardButton::Ptr goBackBtn(new InlineKeyboardButton);
+    goBackBtn->text = "Go Back";
+    goBackBtn->callbackData = CallbackCodec::encode(CallbackAction::FRIENDS_MENU, {std::stoll(userId)});
+
+    InlineKeyboardMarkup::Ptr keyboard(new InlineKeyboardMarkup);
+    keyboard->inlineKeyboard.push_back({goBackBtn});
+
+    sendComparisonChart(bot, std::stol(userId), userStats, friendStats, text, keyboard);
+}
+
+void handleStatsCommand(const Bot& bot, Message::Ptr message)
+{
+    int64_t chatId = message->chat->id;
+
+    if (adminIds.count(chatId) == 0)
+    {
+        logger.log(LogLevel::WARNING, "Ignoring /stats from non-admin chat " + std::to_string(chatId));
+        return;
+    }
+
+    // Telegram caps a message at 4096 characters
+    const size_t maxLength = 4000;
+    char header[160];
+    snprintf(header, sizeof(header), "%-30s %7s %6s %6s %6s %6s\n", "latency (ms)", "count", "p50", "p90", "p99", "max");
+    std::string text = std::string("```\n") + header;
+    size_t omitted = 0;
+
+    for (const LatencySummary& summary : LatencyRegistry::summarizeAll())
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "%-30s %7llu %6.1f %6.1f %6.1f %6.1f\n", summary.name.c_str(),
+                 static_cast<unsigned long long>(summary.count), summary.p50Ms, summary.p90Ms, summary.p99Ms, summary.maxMs);
+
+        if (text.size() + strlen(line) + 32 > maxLength)
+        {
+            omitted++;
+            continue;
+        }
+        text += line;
+    }
+
+    if (omitted > 0)
+    {
+        text += "... " + std::to_string(omitted) + " more\n";
+    }
+    text += "```";
+
+    apiExecutor->post(chatId, [=, &bot]() {
+        bot.getApi().sendMessage(chatId, text, nullptr, 0, nullptr, "Markdown");
+    });
+}
+
+void handleRequestsCommand(const Bot& bot, Message::Ptr message, Message::Ptr editable = nullptr)
 {
     std::string userId = std::to_string(message->chat->id);
 
@@ -452,15 +650,15 @@ void handleRequestsCommand(const Bot& bot, Message::Ptr message)
 
     InlineKeyboardButton::Ptr goBackBtn(new InlineKeyboardButton);
     goBackBtn->text = "Go Back";
-    goBackBtn->callbackData = "friends_menu_" + userId;
+    goBackBtn->callbackData = CallbackCodec::encode(CallbackAction::FRIENDS_MENU, {message->chat->id});
 
     InlineKeyboardButton::Ptr removeInRequestsBtn(new InlineKeyboardButton);
     removeInRequestsBtn->text = "Remove all incoming requests.";
-    removeInRequestsBtn->callbackData = "remove_all_in_requests_" + userId;
+    removeInRequestsBtn->callbackData = CallbackCodec::encode(CallbackAction::REMOVE_ALL_IN_REQUESTS, {message->chat->id});
 
     InlineKeyboardButton::Ptr removeOutRequestsBtn(new InlineKeyboardButton);
     removeOutRequestsBtn->text = "Remove all outcoming requests.";
-    removeOutRequestsBtn->callbackData = "remove_all_out_requests_" + userId;
+    removeOutRequestsBtn->callbackData = CallbackCodec::encode(CallbackAction::REMOVE_ALL_OUT_REQUESTS, {message->chat->id});
 
     InlineKeyboardMarkup::Ptr keyboard(new InlineKeyboardMarkup);
     keyboard->inlineKeyboard.push_back({goBackBtn}); 
@@ -469,355 +667,653 @@ void handleRequestsCommand(const Bot& bot, Message::Ptr message)
 
     text += "\n\nTo accept a request, press the ID to copy and then write /accept (id).\nTo deny/remove an in/outcoming request or a friend, use /remove (id).";
 
-    bot.getApi().sendMessage(message->chat->id, text, nullptr, 0, keyboard, "markdown");
+    showMenu(bot, message->chat->id, text, keyboard, editable, "markdown");
 }
 
-int main() {
-
-    logger.log(LogLevel::INFO, "Bot started");
+// Handlers only need the chat id of the message they answer
+Message::Ptr chatMessage(int64_t chatId)
+{
+    Message::Ptr message = std::make_shared<Message>();
+    message->chat = std::make_shared<Chat>();
+    message->chat->id = chatId;
+    return message;
+}
 
-    printf("\nTeleGacha - A Gacha game integrated in a Telegram Bot.\n");
+// Wrap handlers so their run time lands in the named latency histogram
+EventBroadcaster::MessageListener timedCommand(const std::string& name, EventBroadcaster::MessageListener handler)
+{
+    LatencyHistogram& latency = LatencyRegistry::get(name);
+    return [&latency, handler](const Message::Ptr message) {
+        LatencyTimer timer(latency);
+        handler(message);
+    };
+}
 
-    const char* token(getenv("TELEGACHA_TOKEN"));
-    if (token == nullptr || std::string(token).empty()) {
-        std::cerr << "Error: Bot token is not set!" << std::endl;
-        logger.log(LogLevel::ERROR, "Error: Bot token is not set!");
-        return 1;
-    }
-    else
-        printf("Token: %s\n", token);
+CallbackRouter::ActionHandler timedCallback(const std::string& name, CallbackRouter::ActionHandler handler)
+{
+    LatencyHistogram& latency = LatencyRegistry::get(name);
+    return [&latency, handler](const CallbackQuery::Ptr& query, const CallbackPayload& payload) {
+        LatencyTimer timer(latency);
+        handler(query, payload);
+    };
+}
 
-    Bot bot(token);
+void registerCallbackRoutes(const Bot& bot)
+{
+    callbackRouter.addAction(CallbackAction::CHANGE_NAME, timedCallback("callback change_name", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        logger.log(LogLevel::INFO, std::to_string(payload.field(0)) + " pressed " + query->data);
 
-    UserManager::loadAllUsers();
+        int64_t chatId = query->from->id;
 
-    std::thread backgroundThread(periodicUsersUpdate);
+        conversations->set(chatId, AwaitingNewName{UserManager::getName(std::to_string(chatId))});
 
-    setBotCommands();
+        apiExecutor->post(query->from->id, [=, &bot]() {
+            bot.getApi().sendMessage(query->from->id, "Please enter your new name:");
+        });
+    }));
 
-    bot.getApi().setMyCommands(commands);
+    callbackRouter.addAction(CallbackAction::PROFILE, timedCallback("callback profile", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        if (payload.fieldCount < 1)
+        {
+            return;
+        }
 
-    bot.getEvents().onCommand("start", [&bot](Message::Ptr message) {
-        handleStartCommand(bot, message);
-    });
+        handleProfileCommand(bot, chatMessage(payload.field(0)), query->message);
+    }));
 
+    callbackRouter.addAction(CallbackAction::BACK_TO_MENU, timedCallback("callback back_to_menu", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        if (payload.fieldCount < 1)
+        {
+            return;
+        }
 
-    bot.getEvents().onCommand("help", [&bot](Message::Ptr message) {
-        bot.getApi().sendMessage(message->chat->id, "/help for this message.\n/profile to view your profile.");
-    });
+        handleStartCommand(bot, chatMessage(payload.field(0)), query->message);
+    }));
 
-    bot.getEvents().onCommand("profile", [&bot](Message::Ptr message) {     
-        handleProfileCommand(bot, message);
-    });
+    callbackRouter.addAction(CallbackAction::SEND_FRIEND_REQUEST, timedCallback("callback send_friend_request", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        logger.log(LogLevel::INFO, std::to_string(payload.field(0)) + " pressed " + query->data);
 
-    bot.getEvents().onCommand("friends", [&bot](Message::Ptr message) {     
-        handleFriendsCommand(bot, message);
-    });
+        int64_t chatId = query->from->id;
 
-    bot.getEvents().onCommand("requests", [&bot](Message::Ptr message) {     
-        handleRequestsCommand(bot, message);
-    });
+        conversations->set(chatId, AwaitingFriendId{});
 
+        apiExecutor->post(query->from->id, [=, &bot]() {
+            bot.getApi().sendMessage(query->from->id, "Please enter the userId of your friend:");
+        });
+    }));
 
-    bot.getEvents().onCallbackQuery([&bot](CallbackQuery::Ptr query)
+    callbackRouter.addAction(CallbackAction::VIEW_FRIEND_REQUESTS, timedCallback("callback view_friend_requests", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
     {
-        std::string callbackData = query->data;
+        if (payload.fieldCount < 1)
+        {
+            return;
+        }
+
+        logger.log(LogLevel::INFO, std::to_string(payload.field(0)) + " pressed " + query->data);
 
-        std::string userId;
+        handleRequestsCommand(bot, chatMessage(payload.field(0)), query->message);
+    }));
 
-        if (callbackData.find("change_name_") == 0)
+    callbackRouter.addAction(CallbackAction::FRIENDS_MENU, timedCallback("callback friends_menu", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        if (payload.fieldCount < 1)
         {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+            return;
+        }
 
-            userId = callbackData.substr(12);
+        logger.log(LogLevel::INFO, std::to_string(payload.field(0)) + " pressed " + query->data);
 
-            logger.log(LogLevel::INFO, userId + " pressed " + callbackData);
+        handleFriendsCommand(bot, chatMessage(payload.field(0)), query->message);
+    }));
 
-            int64_t chatId = query->from->id;
+    callbackRouter.addAction(CallbackAction::COMPARE, timedCallback("callback compare", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        if (payload.fieldCount < 2)
+        {
+            return;
+        }
 
-            userStates[chatId] = UserState::WAITING_FOR_NEW_NAME;
+        logger.log(LogLevel::INFO, std::to_string(payload.field(0)) + " pressed " + query->data);
 
-            bot.getApi().sendMessage(query->from->id, "Please enter your new name:");
-        }
-        if (callbackData.find("profile_") == 0)
+        handleCompareCommand(bot, std::to_string(payload.field(0)), std::to_string(payload.field(1)));
+    }));
+
+    callbackRouter.addAction(CallbackAction::REMOVE_ALL_IN_REQUESTS, timedCallback("callback remove_all_in_requests", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        if (payload.fieldCount < 1)
         {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+            return;
+        }
 
-            if (query->message != nullptr && query->message->text != "/start")
+        std::string userId = std::to_string(payload.field(0));
+
+        UserManager::updateUser(userId, [](GameUser& user) {
+            for (const auto& i : user.getIncomingFriendRequests())
             {
-                bot.getApi().deleteMessage(query->message->chat->id, query->message->messageId);
+                user.removeIncomingFriendRequest(i);
             }
+        });
+        UserManager::saveAllUsers();
+
+        logger.log(LogLevel::INFO, userId + " pressed " + query->data);
 
-            userId = callbackData.substr(8);
+        apiExecutor->post(query->from->id, [=, &bot]() {
+            bot.getApi().sendMessage(query->from->id, "Incoming friend requests list cleared.");
+        });
 
-            Message::Ptr message = std::make_shared<Message>();
-            message->chat = std::make_shared<Chat>();
-            message->chat->id = std::stol(userId);
+        handleRequestsCommand(bot, chatMessage(payload.field(0)), query->message);
+    }));
 
-            handleProfileCommand(bot, message);
-        }
-        if (callbackData.find("back_to_menu_") == 0)
+    callbackRouter.addAction(CallbackAction::REMOVE_ALL_OUT_REQUESTS, timedCallback("callback remove_all_out_requests", [&bot](const CallbackQuery::Ptr& query, const CallbackPayload& payload)
+    {
+        if (payload.fieldCount < 1)
         {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+            return;
+        }
+
+        std::string userId = std::to_string(payload.field(0));
 
-            if (query->message != nullptr && query->message->text != "/profile")
+        UserManager::updateUser(userId, [](GameUser& user) {
+            for (const auto& i : user.getOutcomingFriendRequests())
             {
-                bot.getApi().deleteMessage(query->message->chat->id, query->message->messageId);
+                user.removeOutcomingFriendRequest(i);
             }
+        });
+        UserManager::saveAllUsers();
 
-            userId = callbackData.substr(13);
-
-            Message::Ptr message = std::make_shared<Message>();
-            message->chat = std::make_shared<Chat>();
-            message->chat->id = std::stol(userId);
+        logger.log(LogLevel::INFO, userId + " pressed " + query->data);
 
-            handleStartCommand(bot, message);
-        }
-        if (callbackData.find("send_friend_request_") == 0)
-        {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+        apiExecutor->post(query->from->id, [=, &bot]() {
+            bot.getApi().sendMessage(query->from->id, "Incoming friend requests list cleared.");
+        });
+
+        handleRequestsCommand(bot, chatMessage(payload.field(0)), query->message);
+    }));
+
+    // Buttons sent before the compact encoding
+    callbackRouter.addLegacyPrefix("change_name_", CallbackAction::CHANGE_NAME);
+    callbackRouter.addLegacyPrefix("profile_", CallbackAction::PROFILE);
+    callbackRouter.addLegacyPrefix("back_to_menu_", CallbackAction::BACK_TO_MENU);
+    callbackRouter.addLegacyPrefix("send_friend_request_", CallbackAction::SEND_FRIEND_REQUEST);
+    callbackRouter.addLegacyPrefix("view_friend_request_", CallbackAction::VIEW_FRIEND_REQUESTS);
+    callbackRouter.addLegacyPrefix("friends_menu_", CallbackAction::FRIENDS_MENU);
+    callbackRouter.addLegacyPrefix("compare_", CallbackAction::COMPARE);
+    callbackRouter.addLegacyPrefix("remove_all_in_requests_", CallbackAction::REMOVE_ALL_IN_REQUESTS);
+    callbackRouter.addLegacyPrefix("remove_all_out_requests_", CallbackAction::REMOVE_ALL_OUT_REQUESTS);
+}
 
-            userId = callbackData.substr(20);
+// Webhook mode is enabled by TELEGACHA_WEBHOOK_URL, the public URL Telegram posts to
+WebhookConfig webhookConfigFromEnv()
+{
+    WebhookConfig config;
 
-            logger.log(LogLevel::INFO, userId + " pressed " + callbackData);
+    const char* port(getenv("TELEGACHA_WEBHOOK_PORT"));
+    const char* path(getenv("TELEGACHA_WEBHOOK_PATH"));
+    const char* secret(getenv("TELEGACHA_WEBHOOK_SECRET"));
+    const char* certificate(getenv("TELEGACHA_WEBHOOK_CERT"));
+    const char* privateKey(getenv("TELEGACHA_WEBHOOK_KEY"));
+    const char* threads(getenv("TELEGACHA_WEBHOOK_THREADS"));
 
-            int64_t chatId = query->from->id;
+    if (port != nullptr)
+    {
+        config.port = static_cast<unsigned short>(std::stoul(port));
+    }
+    if (path != nullptr)
+    {
+        config.path = path;
+    }
+    if (secret != nullptr && *secret != '\0')
+    {
+        config.secretToken = secret;
+    }
+    else
+    {
+        // Without a secret anyone who finds the URL could post forged updates. Telegram
+        // gets this one through setWebhook, so it only has to last until the next start.
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-";
+        std::random_device random;
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+        for (int i = 0; i < 64; ++i)
+        {
+            config.secretToken += alphabet[pick(random)];
+        }
+        logger.log(LogLevel::INFO, "TELEGACHA_WEBHOOK_SECRET not set, using a random webhook secret");
+    }
+    if (certificate != nullptr && privateKey != nullptr)
+    {
+        config.certificateFile = certificate;
+        config.privateKeyFile = privateKey;
+    }
+    if (threads != nullptr)
+    {
+        config.threads = std::stoul(threads);
+    }
 
-            userStates[chatId] = UserState::WAITING_FOR_FRIEND_ID;
+    return config;
+}
 
-            bot.getApi().sendMessage(query->from->id, "Please enter the userId of your friend:");
-        }
-        if (callbackData.find("view_friend_request_") == 0)
-        {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+int main() {
 
-            userId = callbackData.substr(20);
+    logger.log(LogLevel::INFO, "Bot started");
 
-            logger.log(LogLevel::INFO, userId + " pressed " + callbackData);
+    printf("\nTeleGacha - A Gacha game integrated in a Telegram Bot.\n");
 
-            Message::Ptr message = std::make_shared<Message>();
-            message->chat = std::make_shared<Chat>();
-            message->chat->id = std::stol(userId);
+    const char* token(getenv("TELEGACHA_TOKEN"));
+    if (token == nullptr || std::string(token).empty()) {
+        std::cerr << "Error: Bot token is not set!" << std::endl;
+        logger.log(LogLevel::ERROR, "Error: Bot token is not set!");
+        return 1;
+    }
+    else
+        printf("Token: %s\n", token);
 
-            handleRequestsCommand(bot, message);
-        }
-        if (callbackData.find("friends_menu_") == 0)
-        {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+    // TELEGACHA_API_URL points the bot at another Bot API server, e.g. tools/MockBotApi
+    const char* apiUrl(getenv("TELEGACHA_API_URL"));
+    std::string botApiUrl = apiUrl != nullptr ? apiUrl : "https://api.telegram.org";
+
+    // CurlHttpClient keeps one keep-alive connection per sending thread; the default
+    // client opens a new connection for every call and only speaks https
+#ifdef HAVE_CURL
+    CurlHttpClient httpClient;
+#else
+    BoostHttpOnlySslClient httpClient;
+#endif
+    // Times every outbound Bot API method
+    TimedHttpClient timedHttpClient(httpClient);
+    Bot bot(token, timedHttpClient, botApiUrl);
+
+    const char* apiWorkers(getenv("TELEGACHA_API_WORKERS"));
+    const char* apiGlobalRate(getenv("TELEGACHA_API_GLOBAL_RATE"));
+    const char* apiChatRate(getenv("TELEGACHA_API_CHAT_RATE"));
+
+    ApiRateLimits apiLimits;
+    if (apiGlobalRate != nullptr) apiLimits.globalPerSecond = std::stod(apiGlobalRate);
+    if (apiChatRate != nullptr) apiLimits.chatPerSecond = std::stod(apiChatRate);
+
+    apiExecutor = std::make_unique<ApiExecutor>(apiWorkers != nullptr ? std::stoul(apiWorkers) : 8, 1024, apiLimits);
+    apiExecutor->setForbiddenCallback([](int64_t chatId) {
+        UserManager::setBlockedBot(std::to_string(chatId), true);
+    });
 
-            userId = callbackData.substr(13);
+    UserManager::loadAllUsers();
+    FileIdCache::loadAll();
 
-            logger.log(LogLevel::INFO, userId + " pressed " + callbackData);
+    // Abandoned flows are forgotten after TELEGACHA_CONVERSATION_TTL seconds
+    const char* conversationTtl(getenv("TELEGACHA_CONVERSATION_TTL"));
+    conversations = std::make_unique<ConversationStore>(std::chrono::seconds(conversationTtl != nullptr ? std::stol(conversationTtl) : 600), 100000);
+    conversations->load(conversationsPath);
 
-            Message::Ptr message = std::make_shared<Message>();
-            message->chat = std::make_shared<Chat>();
-            message->chat->id = std::stol(userId);
+    const char* adminIdList(getenv("TELEGACHA_ADMIN_IDS"));
+    if (adminIdList != nullptr)
+    {
+        std::stringstream ids(adminIdList);
+        std::string id;
+        while (std::getline(ids, id, ','))
+        {
+            if (!id.empty())
+            {
+                adminIds.insert(std::stoll(id));
+            }
+        }
+    }
 
-            handleFriendsCommand(bot, message);
+    const char* chartCacheMb(getenv("TELEGACHA_CHART_CACHE_MB"));
+    const char* chartDiskCache(getenv("TELEGACHA_CHART_DISK_CACHE"));
+    const char* chartDiskCacheMb(getenv("TELEGACHA_CHART_DISK_CACHE_MB"));
+    ChartCache::configure((chartCacheMb != nullptr ? std::stoul(chartCacheMb) : 64) * 1024 * 1024,
+                          chartDiskCache != nullptr && std::string(chartDiskCache) == "1",
+                          (chartDiskCacheMb != nullptr ? std::stoul(chartDiskCacheMb) : 256) * 1024 * 1024);
+
+    ChartEncoderSettings encoderSettings;
+    const char* chartFormat(getenv("TELEGACHA_CHART_FORMAT"));
+    const char* chartZlibLevel(getenv("TELEGACHA_CHART_ZLIB_LEVEL"));
+    const char* chartQuality(getenv("TELEGACHA_CHART_QUALITY"));
+    if (chartFormat != nullptr)
+    {
+        std::optional<ChartFormat> format = parseChartFormat(chartFormat);
+        if (format.has_value() && chartFormatAvailable(format.value()))
+        {
+            encoderSettings.format = format.value();
         }
-        if (callbackData.find("remove_all_in_requests_") == 0)
+        else
         {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+            logger.log(LogLevel::WARNING, std::string("Chart format \"") + chartFormat + "\" is not available. Falling back to png.");
+        }
+    }
+    // Out-of-range values make every encode fail, so clamp them here
+    if (chartZlibLevel != nullptr)
+    {
+        int zlibLevel = std::stoi(chartZlibLevel);
+        encoderSettings.zlibLevel = std::clamp(zlibLevel, 0, 9);
+        if (encoderSettings.zlibLevel != zlibLevel)
+        {
+            logger.log(LogLevel::WARNING, "TELEGACHA_CHART_ZLIB_LEVEL " + std::to_string(zlibLevel) + " is outside 0-9. Using " + std::to_string(encoderSettings.zlibLevel) + ".");
+        }
+    }
+    if (chartQuality != nullptr)
+    {
+        int quality = std::stoi(chartQuality);
+        encoderSettings.quality = std::clamp(quality, 0, 100);
+        if (encoderSettings.quality != quality)
+        {
+            logger.log(LogLevel::WARNING, "TELEGACHA_CHART_QUALITY " + std::to_string(quality) + " is outside 0-100. Using " + std::to_string(encoderSettings.quality) + ".");
+        }
+    }
+    setChartEncoderSettings(encoderSettings);
 
-            userId = callbackData.substr(23);
+    // Render the static chart layers for the default stat schema up front
+    warmStatsChartLayers(GameUser("", "", 0).getStats());
 
-            GameUser user = UserManager::loadUser(userId);
+    const char* chartPoolSize(getenv("TELEGACHA_CHART_POOL_SIZE"));
+    if (chartPoolSize != nullptr)
+    {
+        setStatsChartPoolLimit(std::stoul(chartPoolSize));
+    }
 
-            std::vector<std::string> inRequests = user.getIncomingFriendRequests();
+    const char* chartWorkers(getenv("TELEGACHA_CHART_WORKERS"));
+    chartRenderPool = std::make_unique<ChartRenderPool>(chartWorkers != nullptr ? std::stoul(chartWorkers) : std::max(1u, std::thread::hardware_concurrency()), 64);
 
-            for (const auto& i : inRequests)
-            {
-                user.removeIncomingFriendRequest(i);
-            }
+    std::thread backgroundThread(periodicUsersUpdate);
 
-            UserManager::saveUser(user);
-            UserManager::saveAllUsers();
+    setBotCommands();
 
-            logger.log(LogLevel::INFO, userId + " pressed " + callbackData);
+    bot.getApi().setMyCommands(commands);
 
-            Message::Ptr message = std::make_shared<Message>();
-            message->chat = std::make_shared<Chat>();
-            message->chat->id = std::stol(userId);
+    bot.getEvents().onCommand("start", timedCommand("command /start", [&bot](Message::Ptr message) {
+        handleStartCommand(bot, message);
+    }));
 
-            bot.getApi().sendMessage(query->from->id, "Incoming friend requests list cleared.");
 
-            handleRequestsCommand(bot, message);
-        }
-        if (callbackData.find("remove_all_out_requests_") == 0)
-        {
-            //bot.getApi().answerCallbackQuery(query->id, "Processing...");
+    bot.getEvents().onCommand("help", timedCommand("command /help", [&bot](Message::Ptr message) {
+        apiExecutor->post(message->chat->id, [=, &bot]() {
+            bot.getApi().sendMessage(message->chat->id, "/help for this message.\n/profile to view your profile.");
+        });
+    }));
+
+    bot.getEvents().onCommand("profile", timedCommand("command /profile", [&bot](Message::Ptr message) {
+        handleProfileCommand(bot, message);
+    }));
 
-            userId = callbackData.substr(24);
+    bot.getEvents().onCommand("friends", timedCommand("command /friends", [&bot](Message::Ptr message) {
+        handleFriendsCommand(bot, message);
+    }));
 
-            GameUser user = UserManager::loadUser(userId);
+    bot.getEvents().onCommand("requests", timedCommand("command /requests", [&bot](Message::Ptr message) {
+        handleRequestsCommand(bot, message);
+    }));
 
-            std::vector<std::string> outRequests = user.getOutcomingFriendRequests();
 
-            for (const auto& i : outRequests)
-            {
-                user.removeOutcomingFriendRequest(i);
-            }
+    // Admin only; see TELEGACHA_ADMIN_IDS
+    bot.getEvents().onCommand("stats", timedCommand("command /stats", [&bot](Message::Ptr message) {
+        handleStatsCommand(bot, message);
+    }));
 
-            UserManager::saveUser(user);
-            UserManager::saveAllUsers();
+    registerCallbackRoutes(bot);
 
-            logger.log(LogLevel::INFO, userId + " pressed " + callbackData);
+    // "kicked" is how a private chat reports that the user blocked the bot
+    bot.getEvents().onMyChatMember([](ChatMemberUpdated::Ptr update)
+    {
+        if (update->newChatMember == nullptr)
+        {
+            return;
+        }
 
-            Message::Ptr message = std::make_shared<Message>();
-            message->chat = std::make_shared<Chat>();
-            message->chat->id = std::stol(userId);
+        std::string userId = std::to_string(update->chat->id);
+        bool blocked = update->newChatMember->status == "kicked";
 
-            bot.getApi().sendMessage(query->from->id, "Incoming friend requests list cleared.");
+        logger.log(LogLevel::INFO, userId + (blocked ? " blocked the bot." : " unblocked the bot."));
+        UserManager::setBlockedBot(userId, blocked);
+    });
 
-            handleRequestsCommand(bot, message);
+    bot.getEvents().onCallbackQuery([&bot](CallbackQuery::Ptr query)
+    {
+        // Acknowledged before any work so the client stops its spinner right away; the
+        // answer skips the chat's queue pacing and goes out ahead of the handler's calls
+        std::string queryId = query->id;
+        apiExecutor->post(query->from->id, [&bot, queryId]() {
+            bot.getApi().answerCallbackQuery(queryId);
+        }, ApiPriority::IMMEDIATE);
+
+        if (callbackDeduplicator.isDuplicate(query->from->id, query->data))
+        {
+            logger.log(LogLevel::INFO, "Ignoring repeated callback " + query->data + " from " + std::to_string(query->from->id));
+            return;
         }
 
+        if (!callbackRouter.route(query))
+        {
+            logger.log(LogLevel::WARNING, "No handler for callback data " + query->data);
+        }
     });
 
     bot.getEvents().onAnyMessage([&bot](TgBot::Message::Ptr message) {
-        
+        static LatencyHistogram& latency = LatencyRegistry::get("message");
+        LatencyTimer timer(latency);
+
         logger.log(LogLevel::INFO, message->chat->firstName + " " + message->chat->lastName + "(" + std::to_string(message->chat->id) + ") wrote " +
                                 message->text);
 
         int64_t chatId = message->chat->id;
 
-        if (userStates.find(chatId) != userStates.end() && userStates[chatId] == UserState::WAITING_FOR_NEW_NAME) {
-            std::string newName = message->text;
-
-            GameUser user = UserManager::loadUser(std::to_string(message->chat->id));
+        // Writing to the bot means it isn't blocked (anymore)
+        if (UserManager::hasBlockedBot(std::to_string(chatId)))
+        {
+            UserManager::setBlockedBot(std::to_string(chatId), false);
+        }
 
-            logger.log(LogLevel::INFO, std::to_string(message->chat->id) + " changed their gameName (" + user.getGameName() + " -> " + newName + ")");
+        ConversationState state = conversations->get(chatId);
 
-            user.setGameName(newName);
+        if (const AwaitingNewName* rename = std::get_if<AwaitingNewName>(&state)) {
+            std::string newName = message->text;
 
+            logger.log(LogLevel::INFO, std::to_string(message->chat->id) + " changed their gameName (" + rename->previousName + " -> " + newName + ")");
 
-            UserManager::saveUser(user);
+            UserManager::updateUser(std::to_string(message->chat->id), [&](GameUser& user) {
+                user.setGameName(newName);
+            });
 
             UserManager::saveAllUsers();
 
-            userStates.erase(chatId);
+            conversations->clear(chatId);
 
-            bot.getApi().sendMessage(chatId, "Name successfully updated to: " + newName);
+            apiExecutor->post(chatId, [=, &bot]() {
+                bot.getApi().sendMessage(chatId, "Name successfully updated to: " + newName);
+            });
             
             handleProfileCommand(bot, message);
         }
-        else if (userStates.find(chatId) != userStates.end() && userStates[chatId] == UserState::WAITING_FOR_FRIEND_ID) {
+        else if (std::holds_alternative<AwaitingFriendId>(state)) {
             std::string friendId = message->text;
+            std::string userId = std::to_string(message->chat->id);
 
-            GameUser user = UserManager::loadUser(std::to_string(message->chat->id));
+            logger.log(LogLevel::INFO, userId + " is trying to send a request to (" + friendId + ")");
 
-            std::vector<std::string> friends = user.getFriends();
-            std::vector<std::string> outcoming = user.getOutcomingFriendRequests();
+            std::string reply;
+            bool sent = false;
 
-            logger.log(LogLevel::INFO, std::to_string(message->chat->id) + " is trying to send a request to (" + friendId + ")");
+            // Both records change under one lock, so a request or accept handled at the
+            // same time on another shard can't be lost
+            UserManager::updateUser(userId, [&](GameUser& user) {
+                std::vector<std::string> friends = user.getFriends();
+                std::vector<std::string> outcoming = user.getOutcomingFriendRequests();
 
-            if (friendId == user.getId())
-            {
-                logger.log(LogLevel::ERROR, user.getGameName() + "(" + std::to_string(message->chat->id) + ")" + " tried to add themselves as a friend.");
-                bot.getApi().sendMessage(chatId, "You can't add yourself as a friend.");
-            }
-            else if (std::find(friends.begin(), friends.end(), friendId) != friends.end())
-            {
-                std::optional<GameUser> friendUser = UserManager::loadFriend(friendId);
-                logger.log(LogLevel::ERROR, user.getGameName() + "(" + std::to_string(message->chat->id) + ")" + " tried to add (" + friendId + ") as a friend again.");
-                bot.getApi().sendMessage(chatId, "You already have " + friendUser.value().getGameName() + " (" + friendId + ") as a friend.");
-            } else {
-                if (std::find(outcoming.begin(), outcoming.end(), friendId) != outcoming.end())
+                if (friendId == user.getId())
                 {
-                    logger.log(LogLevel::ERROR, user.getGameName() + "(" + std::to_string(message->chat->id) + ")" + " tried to send a duplicate friend request to (" + friendId + ").");
-                    bot.getApi().sendMessage(chatId, "You already have an outcoming friend request for (" + friendId + ").");
-                } else {
-                    std::optional<GameUser> friendUser = UserManager::loadFriend(friendId);
-                    if (friendUser.has_value())
-                    {
-                        user.addOutcomingFriendRequest(friendId);
-                        friendUser.value().addIncomingFriendRequest(user.getId());
-                        int64_t f_friendId = std::stoll(friendId);
-                        if (!bot.getApi().blockedByUser(f_friendId))
-                            bot.getApi().sendMessage(friendId, "You received a new friend request from " + user.getGameName() + " (" + user.getId() + ").");
-                        else
-                            bot.getApi().sendMessage(chatId, "The requested user has blocked the bot. Kindly ask them to unlock the bot to accept the friend request.");
-                        bot.getApi().sendMessage(chatId, "Friend request sent successfully.");
-
-                        logger.log(LogLevel::INFO, std::to_string(message->chat->id) + " successfully sent a request to (" + friendId + ")");
-
-                        UserManager::saveUser(user);
-                        UserManager::saveUser(friendUser.value());
-                    } else
-                    {
-                        logger.log(LogLevel::ERROR, user.getGameName() + "(" + std::to_string(message->chat->id) + ")" + " tried to add a nonexistant user (" + friendId + ") as a friend.");
-                        bot.getApi().sendMessage(chatId, "Can't find a user with userId " + friendId + ".");
-                    }
+                    logger.log(LogLevel::ERROR, user.getGameName() + "(" + userId + ")" + " tried to add themselves as a friend.");
+                    reply = "You can't add yourself as a friend.";
                 }
-                
+                else if (std::find(friends.begin(), friends.end(), friendId) != friends.end())
+                {
+                    logger.log(LogLevel::ERROR, user.getGameName() + "(" + userId + ")" + " tried to add (" + friendId + ") as a friend again.");
+                    reply = "You already have " + UserManager::getName(friendId) + " (" + friendId + ") as a friend.";
+                }
+                else if (std::find(outcoming.begin(), outcoming.end(), friendId) != outcoming.end())
+                {
+                    logger.log(LogLevel::ERROR, user.getGameName() + "(" + userId + ")" + " tried to send a duplicate friend request to (" + friendId + ").");
+                    reply = "You already have an outcoming friend request for (" + friendId + ").";
+                }
+                else if (UserManager::updateUser(friendId, [&](GameUser& friendUser) { friendUser.addIncomingFriendRequest(userId); }))
+                {
+                    user.addOutcomingFriendRequest(friendId);
+                    sent = true;
+                    reply = "Friend request sent successfully.";
+                    logger.log(LogLevel::INFO, userId + " successfully sent a request to (" + friendId + ")");
+                } else
+                {
+                    logger.log(LogLevel::ERROR, user.getGameName() + "(" + userId + ")" + " tried to add a nonexistant user (" + friendId + ") as a friend.");
+                    reply = "Can't find a user with userId " + friendId + ".";
+                }
+            });
+
+            if (sent)
+            {
                 UserManager::saveAllUsers();
+                notifyUser(bot, friendId, "You received a new friend request from " + UserManager::getName(userId) + " (" + userId + ").", chatId);
             }
 
-            userStates.erase(chatId);
+            apiExecutor->post(chatId, [=, &bot]() {
+                bot.getApi().sendMessage(chatId, reply);
+            });
+
+            conversations->clear(chatId);
             
             handleFriendsCommand(bot, message);
         }
         else if (StringTools::startsWith(message->text, "/accept "))
         {
             std::string friendId = message->text.substr(8);
+            std::string userId = std::to_string(message->chat->id);
+            bool accepted = false;
+
+            UserManager::updateUser(userId, [&](GameUser& user) {
+                std::vector<std::string> incoming = user.getIncomingFriendRequests();
+
+                if (std::find(incoming.begin(), incoming.end(), friendId) == incoming.end())
+                {
+                    return;
+                }
+
+                accepted = UserManager::updateUser(friendId, [&](GameUser& friendUser) {
+                    friendUser.addFriend(userId);
+                    friendUser.removeIncomingFriendRequest(userId);
+                    friendUser.removeOutcomingFriendRequest(userId);
+                });
 
-            GameUser user = UserManager::loadUser(std::to_string(message->chat->id));
+                if (accepted)
+                {
+                    user.addFriend(friendId);
+                    user.removeIncomingFriendRequest(friendId);
+                    user.removeOutcomingFriendRequest(friendId);
+                }
+            });
 
-            std::vector<std::string> incoming = user.getIncomingFriendRequests();
+            std::string userName = UserManager::getName(userId);
 
-            if (std::find(incoming.begin(), incoming.end(), friendId) != incoming.end())
+            if (accepted)
             {
-                GameUser friendUser = UserManager::loadUser(friendId);
-
-                user.addFriend(friendId);
-                friendUser.addFriend(user.getId());
-                user.removeIncomingFriendRequest(friendId);
-                user.removeOutcomingFriendRequest(friendId);
-                friendUser.removeIncomingFriendRequest(user.getId());
-                friendUser.removeOutcomingFriendRequest(user.getId());
-
-                UserManager::saveUser(user);
-                UserManager::saveUser(friendUser);
-
-                logger.log(LogLevel::INFO, user.getGameName() + "(" + std::to_string(message->chat->id) + ")" + " accepted " + UserManager::getName(friendId) + "(" + friendId + ")'s friend request.");
-                bot.getApi().sendMessage(chatId, "You accepted " + UserManager::getName(friendId) + "(" + friendId + ")'s friend request.");
-                int64_t f_friendId = std::stoll(friendId);
-                if (!bot.getApi().blockedByUser(f_friendId))
-                    bot.getApi().sendMessage(friendId, user.getGameName() + "accepted your friend request.");
-                else
-                    bot.getApi().sendMessage(chatId, "The requested user has blocked the bot. Kindly ask them to unlock the bot to accept the friend request.");
+                UserManager::saveAllUsers();
+
+                logger.log(LogLevel::INFO, userName + "(" + userId + ")" + " accepted " + UserManager::getName(friendId) + "(" + friendId + ")'s friend request.");
+                apiExecutor->post(chatId, [=, &bot]() {
+                    bot.getApi().sendMessage(chatId, "You accepted " + UserManager::getName(friendId) + "(" + friendId + ")'s friend request.");
+                });
+                notifyUser(bot, friendId, userName + "accepted your friend request.", chatId);
             } else {
-                logger.log(LogLevel::ERROR, user.getGameName() + "(" + std::to_string(message->chat->id) + ")" + " tried to accept a nonexistant request from (" + friendId + ").");
-                bot.getApi().sendMessage(chatId, "Can't find a request sent by " + friendId + ".");
+                logger.log(LogLevel::ERROR, userName + "(" + userId + ")" + " tried to accept a nonexistant request from (" + friendId + ").");
+                apiExecutor->post(chatId, [=, &bot]() {
+                    bot.getApi().sendMessage(chatId, "Can't find a request sent by " + friendId + ".");
+                });
             }
-
-            UserManager::saveAllUsers();
         }
     });
 
+    // Stops polling; queued updates are still handled before the bot exits
     signal(SIGINT, [](int s) {
-        printf("SIGINT got\n");
-        logger.log(LogLevel::ERROR, "Caught a SIGINT. Bot shutting down.");
-        exit(0);
+        botRunning = false;
     });
 
+    const char* updateWorkers(getenv("TELEGACHA_UPDATE_WORKERS"));
+    const char* updateQueue(getenv("TELEGACHA_UPDATE_QUEUE"));
+    updateDispatcher = std::make_unique<UpdateDispatcher>(bot.getEventHandler(),
+                                                          updateWorkers != nullptr ? std::stoul(updateWorkers) : std::max(1u, std::thread::hardware_concurrency()),
+                                                          updateQueue != nullptr ? std::stoul(updateQueue) : 256);
+
     try {
         printf("Bot username: %s\n\n", bot.getApi().getMe()->username.c_str());
-        bot.getApi().deleteWebhook();
 
-        TgLongPoll longPoll(bot);
-        while (true) {
+        const char* webhookUrl(getenv("TELEGACHA_WEBHOOK_URL"));
+
+        if (webhookUrl != nullptr) {
+            WebhookConfig webhookConfig = webhookConfigFromEnv();
+
+            // Telegram retries an update until it gets a 200, so answer only once it is queued
+            WebhookServer webhookServer(webhookConfig, [](const std::string& body) {
+                TgTypeParser parser;
+                if (!updateDispatcher->dispatch(parser.parseJsonAndGetUpdate(parser.parseJson(body))))
+                {
+                    throw std::runtime_error("Update queue is closed");
+                }
+            });
+            webhookServer.start();
+
+            bot.getApi().setWebhook(webhookUrl, nullptr, 40, nullptr, "", false, webhookConfig.secretToken);
+            printf("Webhook set to %s\n", webhookUrl);
+
+            while (botRunning) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+
+            webhookServer.stop();
+        } else {
+            bot.getApi().deleteWebhook();
+
+            // Same long polling as TgLongPoll, but updates go to the dispatcher instead of
+            // being handled on this thread
+            int32_t lastUpdateId = 0;
             printf("Long poll started\n");
-            longPoll.start();
+            while (botRunning) {
+                std::vector<Update::Ptr> updates;
+                try {
+                    updates = bot.getApi().getUpdates(lastUpdateId, 100, 10);
+                } catch (std::exception& e) {
+                    // The HTTP client doesn't retry, so a network hiccup lands here
+                    logger.log(LogLevel::WARNING, std::string("getUpdates failed: ") + e.what() + ". Retrying in 1s.");
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                    continue;
+                }
+
+                for (const Update::Ptr& update : updates) {
+                    if (update->updateId >= lastUpdateId) {
+                        lastUpdateId = update->updateId + 1;
+                    }
+                    updateDispatcher->dispatch(update);
+                }
+            }
         }
+
+        printf("SIGINT got\n");
+        logger.log(LogLevel::ERROR, "Caught a SIGINT. Bot shutting down.");
     } catch (std::exception& e) {
         printf("error: %s\n", e.what());
         std::string errorMessage = std::string("Caught an exception: ") + e.what();
         logger.log(LogLevel::ERROR, errorMessage);
     }
 
+    updateDispatcher->shutdown();
+
     updaterRunning = false;
     backgroundThread.join();
 
+    chartRenderPool->shutdown();
+    apiExecutor->shutdown();
+
+    UserManager::saveAllUsers();
+    conversations->save(conversationsPath);
+    FileIdCache::saveIfDirty();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,678 @@
+// Local stand-in for the Telegram Bot API, for measuring the bot end to end without
+// talking to Telegram. It answers the methods TeleGacha uses, serves a generated (or
+// recorded) stream of updates through getUpdates at a target rate, and reports
+// throughput, latency percentiles and outbound call counts.
+//
+// Run the bot with TELEGACHA_API_URL=http://127.0.0.1:8081 (CurlHttpClient builds) or
+// start the mock with --cert/--key and use https:// otherwise. Synthetic users are
+// created in the bot's data directory, so point it at a scratch copy.
+//
+// Usage: MockBotApi [--port P] [--rate UPDATES_PER_S] [--duration S] [--users N]
+//                   [--mix all|commands|friends|callbacks] [--replay updates.jsonl]
+//                   [--latency-ms MS] [--jitter-ms MS] [--error-rate P] [--forbidden-rate P]
+//                   [--cert FILE --key FILE]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "../include/CallbackCodec.hpp"
+#include "../include/json.hpp"
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct MockOptions
+{
+    std::string address = "127.0.0.1";
+    unsigned short port = 8081;
+    double rate = 50.0;
+    int duration = 30;
+    int users = 200;
+    std::string mix = "all";
+    std::string replayFile;
+    int latencyMs = 0;
+    int jitterMs = 0;
+    double errorRate = 0.0;
+    double forbiddenRate = 0.0;
+    std::string certificateFile;
+    std::string privateKeyFile;
+};
+
+static double percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * (samples.size() - 1) + 0.5))];
+}
+
+// Everything the connections and the generator share
+class MockState
+{
+public:
+    explicit MockState(const MockOptions& options) : options(options), random(std::random_device()()) {}
+
+    void enqueue(json update)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            update["update_id"] = nextUpdateId++;
+            pending.push_back(std::move(update));
+            generated++;
+        }
+        updatesReady.notify_all();
+    }
+
+    // Long poll: waits up to `timeout` seconds for updates
+    json takeUpdates(size_t limit, int timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        updatesReady.wait_for(lock, std::chrono::seconds(std::clamp(timeout, 0, 10)), [this]() { return !pending.empty(); });
+
+        json result = json::array();
+        auto now = Clock::now();
+
+        while (!pending.empty() && result.size() < limit)
+        {
+            json update = std::move(pending.front());
+            pending.pop_front();
+
+            if (update.contains("callback_query"))
+            {
+                const json& query = update["callback_query"];
+                callbackDelivered[query["id"].get<std::string>()] = now;
+                waitingChats[query["from"]["id"].get<int64_t>()].push_back(now);
+            }
+            else if (update.contains("message"))
+            {
+                waitingChats[update["message"]["chat"]["id"].get<int64_t>()].push_back(now);
+            }
+
+            delivered++;
+            result.push_back(std::move(update));
+        }
+
+        return result;
+    }
+
+    // The first outbound call for a chat answers the oldest update delivered for it
+    void recordCall(const std::string& method, int64_t chatId, const std::string& callbackQueryId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = Clock::now();
+        calls[method]++;
+
+        if (!callbackQueryId.empty())
+        {
+            auto it = callbackDelivered.find(callbackQueryId);
+            if (it != callbackDelivered.end())
+            {
+                ackLatencies.push_back(std::chrono::duration<double, std::milli>(now - it->second).count());
+                callbackDelivered.erase(it);
+            }
+            return;
+        }
+
+        auto it = waitingChats.find(chatId);
+        if (it != waitingChats.end() && !it->second.empty())
+        {
+            handlerLatencies.push_back(std::chrono::duration<double, std::milli>(now - it->second.front()).count());
+            it->second.pop_front();
+            answered++;
+        }
+    }
+
+    // 0 for a normal answer, or the error code to inject
+    int injectedError()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        double roll = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+
+        if (roll < options.errorRate)
+        {
+            injected429++;
+            return 429;
+        }
+        if (roll < options.errorRate + options.forbiddenRate)
+        {
+            injected403++;
+            return 403;
+        }
+        return 0;
+    }
+
+    int delayMs()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return options.latencyMs + (options.jitterMs > 0 ? std::uniform_int_distribution<int>(0, options.jitterMs)(random) : 0);
+    }
+
+    int64_t nextMessageId()
+    {
+        return messageIds++;
+    }
+
+    void report(double seconds, bool final)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        size_t totalCalls = 0;
+        for (const auto& [method, count] : calls)
+        {
+            totalCalls += count;
+        }
+
+        printf("[%6.1fs] updates generated %zu, delivered %zu, answered %zu (%.1f/s), outbound calls %zu (%.1f/s)\n",
+               seconds, generated, delivered, answered, answered / seconds, totalCalls, totalCalls / seconds);
+
+        if (!final)
+        {
+            return;
+        }
+
+        printf("\nHandler latency (delivery -> first reply in the chat) over %zu updates: p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n",
+               handlerLatencies.size(), percentile(handlerLatencies, 0.50), percentile(handlerLatencies, 0.95), percentile(handlerLatencies, 0.99));
+        printf("Callback acknowledgement latency over %zu callbacks: p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n",
+               ackLatencies.size(), percentile(ackLatencies, 0.50), percentile(ackLatencies, 0.95), percentile(ackLatencies, 0.99));
+
+        printf("\nOutbound calls:\n");
+        for (const auto& [method, count] : calls)
+        {
+            printf("  %-22s %8zu\n", method.c_str(), count);
+        }
+        printf("Injected errors: 429 x %zu, 403 x %zu\n", injected429, injected403);
+    }
+
+    const MockOptions options;
+
+private:
+    std::mutex mutex;
+    std::condition_variable updatesReady;
+    std::mt19937 random;
+
+    std::deque<json> pending;
+    int64_t nextUpdateId = 1;
+    std::atomic<int64_t> messageIds{1};
+
+    std::unordered_map<int64_t, std::deque<Clock::time_point>> waitingChats;
+    std::unordered_map<std::string, Clock::time_point> callbackDelivered;
+    std::vector<double> handlerLatencies;
+    std::vector<double> ackLatencies;
+    std::map<std::string, size_t> calls;
+
+    size_t generated = 0;
+    size_t delivered = 0;
+    size_t answered = 0;
+    size_t injected429 = 0;
+    size_t injected403 = 0;
+};
+
+static std::string urlDecode(const std::string& text)
+{
+    std::string decoded;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '+')
+        {
+            decoded += ' ';
+        }
+        else if (text[i] == '%' && i + 2 < text.size())
+        {
+            decoded += static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            decoded += text[i];
+        }
+    }
+    return decoded;
+}
+
+// Reads one argument from a urlencoded or multipart/form-data body
+static std::string formValue(const std::string& body, const std::string& contentType, const std::string& name)
+{
+    if (contentType.find("multipart/form-data") != std::string::npos)
+    {
+        size_t at = body.find("name=\"" + name + "\"");
+        if (at == std::string::npos)
+        {
+            return "";
+        }
+        size_t start = body.find("\r\n\r\n", at);
+        size_t end = start == std::string::npos ? std::string::npos : body.find("\r\n", start + 4);
+        return end == std::string::npos ? "" : body.substr(start + 4, end - start - 4);
+    }
+
+    std::istringstream fields(body);
+    for (std::string field; std::getline(fields, field, '&');)
+    {
+        size_t equals = field.find('=');
+        if (equals != std::string::npos && urlDecode(field.substr(0, equals)) == name)
+        {
+            return urlDecode(field.substr(equals + 1));
+        }
+    }
+    return "";
+}
+
+static json mockMessage(MockState& state, int64_t chatId, bool photo)
+{
+    json message = {
+        {"message_id", state.nextMessageId()},
+        {"date", std::time(nullptr)},
+        {"chat", {{"id", chatId}, {"type", "private"}}},
+        {"text", ""}
+    };
+
+    if (photo)
+    {
+        std::string fileId = "mock-photo-" + std::to_string(message["message_id"].get<int64_t>());
+        message.erase("text");
+        message["photo"] = json::array({{{"file_id", fileId}, {"file_unique_id", fileId}, {"width", 500}, {"height", 500}}});
+    }
+
+    return message;
+}
+
+// Builds the response body for one Bot API call; sets `status` for injected errors
+static std::string handleCall(MockState& state, const std::string& method, const std::string& body, const std::string& contentType, int& status)
+{
+    status = 200;
+
+    if (method == "getUpdates")
+    {
+        std::string limit = formValue(body, contentType, "limit");
+        std::string timeout = formValue(body, contentType, "timeout");
+        json updates = state.takeUpdates(limit.empty() ? 100 : std::stoul(limit), timeout.empty() ? 0 : std::stoi(timeout));
+        return json({{"ok", true}, {"result", updates}}).dump();
+    }
+    if (method == "getMe")
+    {
+        return json({{"ok", true}, {"result", {{"id", 1}, {"is_bot", true}, {"first_name", "Mock"}, {"username", "mock_bot"}}}}).dump();
+    }
+
+    std::string chatIdText = formValue(body, contentType, "chat_id");
+    int64_t chatId = chatIdText.empty() ? 0 : std::strtoll(chatIdText.c_str(), nullptr, 10);
+    std::string callbackQueryId = method == "answerCallbackQuery" ? formValue(body, contentType, "callback_query_id") : "";
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(state.delayMs()));
+    state.recordCall(method, chatId, callbackQueryId);
+
+    int error = method == "answerCallbackQuery" ? 0 : state.injectedError();
+    if (error == 429)
+    {
+        status = 429;
+        return json({{"ok", false}, {"error_code", 429}, {"description", "Too Many Requests: retry after 1"}, {"parameters", {{"retry_after", 1}}}}).dump();
+    }
+    if (error == 403)
+    {
+        status = 403;
+        return json({{"ok", false}, {"error_code", 403}, {"description", "Forbidden: bot was blocked by the user"}}).dump();
+    }
+
+    if (method == "sendMessage" || method == "editMessageText")
+    {
+        return json({{"ok", true}, {"result", mockMessage(state, chatId, false)}}).dump();
+    }
+    if (method == "sendPhoto" || method == "editMessageMedia")
+    {
+        return json({{"ok", true}, {"result", mockMessage(state, chatId, true)}}).dump();
+    }
+
+    return json({{"ok", true}, {"result", true}}).dump();
+}
+
+// Serves one keep-alive connection until the client closes it
+template <typename Stream>
+static void serve(Stream& stream, MockState& state)
+{
+    asio::streambuf buffer;
+
+    while (true)
+    {
+        size_t headerBytes = asio::read_until(stream, buffer, "\r\n\r\n");
+        std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerBytes);
+        buffer.consume(headerBytes);
+
+        std::istringstream lines(headers);
+        std::string requestMethod, target, line, contentType;
+        size_t contentLength = 0;
+        lines >> requestMethod >> target;
+        std::getline(lines, line);
+
+        while (std::getline(lines, line) && line != "\r")
+        {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            value.erase(value.find_last_not_of("\r ") + 1);
+
+            if (name == "content-length")
+            {
+                contentLength = std::strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (name == "content-type")
+            {
+                contentType = value;
+            }
+        }
+
+        if (buffer.size() < contentLength)
+        {
+            asio::read(stream, buffer, asio::transfer_exactly(contentLength - buffer.size()));
+        }
+        std::string body(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + contentLength);
+        buffer.consume(contentLength);
+
+        // /bot<token>/<method>[?query]; GET requests carry their arguments in the query
+        size_t query = target.find('?');
+        if (query != std::string::npos && body.empty())
+        {
+            body = target.substr(query + 1);
+            contentType = "application/x-www-form-urlencoded";
+        }
+        std::string path = target.substr(0, query);
+        std::string method = path.substr(path.find_last_of('/') + 1);
+
+        int status = 200;
+        std::string response = handleCall(state, method, body, contentType, status);
+
+        std::string reply = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Error") + "\r\n" +
+                            "Content-Type: application/json\r\n" +
+                            "Content-Length: " + std::to_string(response.size()) + "\r\n" +
+                            "Connection: keep-alive\r\n\r\n" + response;
+        asio::write(stream, asio::buffer(reply));
+    }
+}
+
+static json userJson(int64_t id)
+{
+    return {{"id", id}, {"is_bot", false}, {"first_name", "Load"}, {"username", "load" + std::to_string(id)}};
+}
+
+static json messageUpdate(int64_t chatId, const std::string& text)
+{
+    json message = {
+        {"message_id", 1},
+        {"date", std::time(nullptr)},
+        {"from", userJson(chatId)},
+        {"chat", {{"id", chatId}, {"type", "private"}, {"first_name", "Load"}, {"username", "load" + std::to_string(chatId)}}},
+        {"text", text}
+    };
+
+    if (!text.empty() && text[0] == '/')
+    {
+        size_t length = std::min(text.find(' '), text.size());
+        message["entities"] = json::array({{{"offset", 0}, {"length", length}, {"type", "bot_command"}}});
+    }
+
+    return {{"message", message}};
+}
+
+static json callbackUpdate(int64_t chatId, const std::string& data)
+{
+    static std::atomic<uint64_t> queryIds(1);
+
+    json message = {
+        {"message_id", 1},
+        {"date", std::time(nullptr)},
+        {"chat", {{"id", chatId}, {"type", "private"}}},
+        {"text", "menu"}
+    };
+
+    return {{"callback_query", {{"id", "mock-query-" + std::to_string(queryIds++)}, {"from", userJson(chatId)},
+                                {"message", message}, {"chat_instance", "1"}, {"data", data}}}};
+}
+
+// A step of a scenario: the update and how long after the scenario starts it is sent
+struct ScheduledUpdate
+{
+    Clock::time_point at;
+    json update;
+
+    bool operator>(const ScheduledUpdate& other) const
+    {
+        return at > other.at;
+    }
+};
+
+static std::vector<std::pair<int, json>> scenario(const std::string& kind, int64_t user, int64_t other)
+{
+    static const char* commands[] = {"/start", "/profile", "/friends", "/requests", "/help"};
+
+    if (kind == "friends")
+    {
+        // Request, type the friend's id, then the friend accepts
+        return {
+            {0, callbackUpdate(user, CallbackCodec::encode(CallbackAction::SEND_FRIEND_REQUEST, {user}))},
+            {300, messageUpdate(user, std::to_string(other))},
+            {1000, messageUpdate(other, "/accept " + std::to_string(user))}
+        };
+    }
+    if (kind == "callbacks")
+    {
+        // Navigation with a double tap on the profile button
+        std::string profile = CallbackCodec::encode(CallbackAction::PROFILE, {user});
+        return {
+            {0, callbackUpdate(user, profile)},
+            {80, callbackUpdate(user, profile)},
+            {600, callbackUpdate(user, CallbackCodec::encode(CallbackAction::BACK_TO_MENU, {user}))},
+            {1200, callbackUpdate(user, CallbackCodec::encode(CallbackAction::FRIENDS_MENU, {user}))}
+        };
+    }
+
+    return {{0, messageUpdate(user, commands[user % 5])}};
+}
+
+// Feeds the update queue at the target rate until the run is over
+static void generate(MockState& state, const std::vector<json>& recorded, Clock::time_point end)
+{
+    const MockOptions& options = state.options;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int64_t> users(0, options.users - 1);
+    const char* kinds[] = {"commands", "friends", "callbacks"};
+
+    std::priority_queue<ScheduledUpdate, std::vector<ScheduledUpdate>, std::greater<ScheduledUpdate>> scheduled;
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.rate));
+    auto next = Clock::now();
+    size_t step = 0;
+
+    // Every user starts with /start so the bot knows them
+    for (int i = 0; i < options.users && recorded.empty(); ++i)
+    {
+        state.enqueue(messageUpdate(100000 + i, "/start"));
+    }
+
+    while (Clock::now() < end)
+    {
+        auto now = Clock::now();
+
+        while (next <= now)
+        {
+            if (!recorded.empty())
+            {
+                scheduled.push({next, recorded[step % recorded.size()]});
+            }
+            else
+            {
+                std::string kind = options.mix == "all" ? kinds[step % 3] : options.mix;
+                int64_t user = 100000 + users(random);
+                int64_t other = 100000 + users(random);
+
+                for (auto& [delayMs, update] : scenario(kind, user, other == user ? 100000 + (user - 99999) % options.users : other))
+                {
+                    scheduled.push({next + std::chrono::milliseconds(delayMs), std::move(update)});
+                }
+            }
+
+            step++;
+            next += interval;
+        }
+
+        while (!scheduled.empty() && scheduled.top().at <= now)
+        {
+            state.enqueue(scheduled.top().update);
+            scheduled.pop();
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+static bool parseOptions(int argc, char* argv[], MockOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--address") options.address = value;
+        else if (arg == "--port") options.port = static_cast<unsigned short>(std::atoi(value.c_str()));
+        else if (arg == "--rate") options.rate = std::max(0.1, std::atof(value.c_str()));
+        else if (arg == "--duration") options.duration = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--users") options.users = std::max(2, std::atoi(value.c_str()));
+        else if (arg == "--mix") options.mix = value;
+        else if (arg == "--replay") options.replayFile = value;
+        else if (arg == "--latency-ms") options.latencyMs = std::max(0, std::atoi(value.c_str()));
+        else if (arg == "--jitter-ms") options.jitterMs = std::max(0, std::atoi(value.c_str()));
+        else if (arg == "--error-rate") options.errorRate = std::atof(value.c_str());
+        else if (arg == "--forbidden-rate") options.forbiddenRate = std::atof(value.c_str());
+        else if (arg == "--cert") options.certificateFile = value;
+        else if (arg == "--key") options.privateKeyFile = value;
+        else return false;
+    }
+
+    return options.mix == "all" || options.mix == "commands" || options.mix == "friends" || options.mix == "callbacks";
+}
+
+int main(int argc, char* argv[])
+{
+    MockOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "Usage: %s [--port P] [--rate UPDATES_PER_S] [--duration S] [--users N] [--mix all|commands|friends|callbacks]\n"
+                        "       [--replay updates.jsonl] [--latency-ms MS] [--jitter-ms MS] [--error-rate P] [--forbidden-rate P]\n"
+                        "       [--cert FILE --key FILE]\n", argv[0]);
+        return 2;
+    }
+
+    // Recorded updates are replayed in a loop; their update_id is replaced
+    std::vector<json> recorded;
+    if (!options.replayFile.empty())
+    {
+        std::ifstream file(options.replayFile);
+        for (std::string line; std::getline(file, line);)
+        {
+            if (!line.empty())
+            {
+                recorded.push_back(json::parse(line));
+            }
+        }
+
+        if (recorded.empty())
+        {
+            fprintf(stderr, "No updates in %s\n", options.replayFile.c_str());
+            return 2;
+        }
+    }
+
+    MockState state(options);
+
+    asio::io_context io;
+    tcp::acceptor acceptor(io, tcp::endpoint(asio::ip::make_address(options.address), options.port));
+
+    std::unique_ptr<asio::ssl::context> tls;
+    if (!options.certificateFile.empty() && !options.privateKeyFile.empty())
+    {
+        tls = std::make_unique<asio::ssl::context>(asio::ssl::context::tls_server);
+        tls->use_certificate_chain_file(options.certificateFile);
+        tls->use_private_key_file(options.privateKeyFile, asio::ssl::context::pem);
+    }
+
+    printf("Mock Bot API listening on %s://%s:%u, %s for %d s at %.1f/s\n", tls ? "https" : "http", options.address.c_str(), options.port,
+           recorded.empty() ? ("mix " + options.mix).c_str() : options.replayFile.c_str(), options.duration, options.rate);
+
+    // One thread per connection; the bot keeps only a few open
+    std::thread([&]() {
+        while (true)
+        {
+            tcp::socket socket(io);
+            acceptor.accept(socket);
+            socket.set_option(tcp::no_delay(true));
+
+            std::thread([&state, &tls, socket = std::move(socket)]() mutable {
+                try
+                {
+                    if (tls)
+                    {
+                        asio::ssl::stream<tcp::socket> stream(std::move(socket), *tls);
+                        stream.handshake(asio::ssl::stream_base::server);
+                        serve(stream, state);
+                    }
+                    else
+                    {
+                        serve(socket, state);
+                    }
+                }
+                catch (std::exception&)
+                {
+                    // Client closed the connection
+                }
+            }).detach();
+        }
+    }).detach();
+
+    auto start = Clock::now();
+    auto end = start + std::chrono::seconds(options.duration);
+
+    std::thread generator(generate, std::ref(state), std::cref(recorded), end);
+
+    while (Clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::min<Clock::duration>(std::chrono::seconds(5), end - Clock::now()));
+        state.report(std::chrono::duration<double>(Clock::now() - start).count(), false);
+    }
+
+    generator.join();
+
+    // Give the bot a moment to answer what it has already received
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    state.report(std::chrono::duration<double>(Clock::now() - start).count(), true);
+
+    std::fflush(stdout);
+    std::_Exit(0);
+}
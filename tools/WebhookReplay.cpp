@@ -0,0 +1,194 @@
+// Stand-in for Telegram's webhook delivery: posts recorded updates (one JSON object per
+// line) to a running bot over keep-alive connections and reports the results.
+//
+// Usage: WebhookReplay <updates.jsonl> [--host H] [--port P] [--path /p] [--secret S]
+//                      [--connections N] [--repeat R] [--tls]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+struct ReplayOptions
+{
+    std::string file;
+    std::string host = "127.0.0.1";
+    std::string port = "8443";
+    std::string path = "/";
+    std::string secret;
+    int connections = 4;
+    int repeat = 1;
+    bool tls = false;
+};
+
+// Sends one request and reads the response headers; returns the status code
+template <typename Stream>
+static int post(Stream& stream, asio::streambuf& buffer, const ReplayOptions& options, const std::string& body)
+{
+    std::string request = "POST " + options.path + " HTTP/1.1\r\n" +
+                          "Host: " + options.host + "\r\n" +
+                          "Content-Type: application/json\r\n" +
+                          "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                          "Connection: keep-alive\r\n";
+    if (!options.secret.empty())
+    {
+        request += "X-Telegram-Bot-Api-Secret-Token: " + options.secret + "\r\n";
+    }
+    request += "\r\n" + body;
+
+    asio::write(stream, asio::buffer(request));
+
+    size_t headerBytes = asio::read_until(stream, buffer, "\r\n\r\n");
+    std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerBytes);
+    buffer.consume(headerBytes);
+
+    // The bot answers with an empty body
+    int status = 0;
+    std::sscanf(headers.c_str(), "HTTP/%*s %d", &status);
+    return status;
+}
+
+template <typename Stream>
+static void replay(Stream& stream, const ReplayOptions& options, const std::vector<std::string>& updates, std::atomic<size_t>& next,
+                   std::vector<double>& latencies, std::atomic<size_t>& failures)
+{
+    asio::streambuf buffer;
+    size_t total = updates.size() * options.repeat;
+
+    for (size_t index = next++; index < total; index = next++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int status = post(stream, buffer, options, updates[index % updates.size()]);
+        latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        if (status != 200)
+        {
+            failures++;
+        }
+    }
+}
+
+static bool parseOptions(int argc, char* argv[], ReplayOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--host" && hasValue) options.host = argv[++i];
+        else if (arg == "--port" && hasValue) options.port = argv[++i];
+        else if (arg == "--path" && hasValue) options.path = argv[++i];
+        else if (arg == "--secret" && hasValue) options.secret = argv[++i];
+        else if (arg == "--connections" && hasValue) options.connections = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--repeat" && hasValue) options.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--tls") options.tls = true;
+        else if (options.file.empty() && arg[0] != '-') options.file = arg;
+        else return false;
+    }
+
+    return !options.file.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    ReplayOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "Usage: %s <updates.jsonl> [--host H] [--port P] [--path /p] [--secret S] [--connections N] [--repeat R] [--tls]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::string> updates;
+    std::ifstream file(options.file);
+    for (std::string line; std::getline(file, line);)
+    {
+        if (!line.empty())
+        {
+            updates.push_back(line);
+        }
+    }
+
+    if (updates.empty())
+    {
+        fprintf(stderr, "No updates in %s\n", options.file.c_str());
+        return 2;
+    }
+
+    asio::io_context io;
+    tcp::resolver resolver(io);
+    auto endpoints = resolver.resolve(options.host, options.port);
+
+    // Self-signed certificates are the norm for local testing, so the peer isn't verified
+    asio::ssl::context tls(asio::ssl::context::tls_client);
+    tls.set_verify_mode(asio::ssl::verify_none);
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failures(0);
+    std::vector<std::vector<double>> latencies(options.connections);
+    std::vector<std::thread> workers;
+    std::mutex errorMutex;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int c = 0; c < options.connections; ++c)
+    {
+        workers.emplace_back([&, c]() {
+            try
+            {
+                if (options.tls)
+                {
+                    asio::ssl::stream<tcp::socket> stream(io, tls);
+                    asio::connect(stream.lowest_layer(), endpoints);
+                    stream.handshake(asio::ssl::stream_base::client);
+                    replay(stream, options, updates, next, latencies[c], failures);
+                }
+                else
+                {
+                    tcp::socket stream(io);
+                    asio::connect(stream, endpoints);
+                    replay(stream, options, updates, next, latencies[c], failures);
+                }
+            }
+            catch (std::exception& e)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                fprintf(stderr, "Connection %d failed: %s\n", c, e.what());
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const auto& samples : latencies)
+    {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    auto percentile = [&all](double p) { return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * (all.size() - 1) + 0.5))]; };
+
+    printf("Posted %zu updates over %d connections in %.3f s (%.1f updates/s)\n", all.size(), options.connections, seconds, all.size() / seconds);
+    printf("Non-200 responses: %zu\n", failures.load());
+    printf("Latency p50 %.3f ms, p99 %.3f ms\n", percentile(0.50), percentile(0.99));
+
+    return failures > 0 || all.size() != updates.size() * options.repeat ? 1 : 0;
+}